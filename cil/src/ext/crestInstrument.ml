@@ -56,8 +56,8 @@ let open_append fname =
  *
  * Because the CIL executable will be run once per source file in the
  * instrumented program, we must save/restore this state in files
- * between CIL executions.  (These last two bits of state are
- * write-only -- at the end of each run we just append updates.)
+ * between CIL executions.  (The branches, CFG, and map are write-only
+ * -- at the end of each run we just write the file's CFG fragment.)
  *)
 
 let idCount = ref 0
@@ -95,84 +95,167 @@ let writeIdCount () = writeCounter "idcount" !idCount
 let writeStmtCount () = writeCounter "stmtcount" !stmtCount
 let writeFunCount () = writeCounter "funcount" !funCount
 
-let writeBranches () =
-  let writeFunBranches out (fid, bs) =
-    if (fid > 0) then
-      (let sorted = List.sort compare bs in
-         Printf.fprintf out "%d %d\n" fid (List.length bs) ;
-         List.iter (fun (s,d) -> Printf.fprintf out "%d %d\n" s d) sorted)
+let buildFirstStmtIdMap cilFile =
+  let getFirstFuncStmtId glob =
+    match glob with
+      | GFun(f, _) -> Some (f.svar, List.hd f.sbody.bstmts)
+      | _ -> None
   in
-    try
-      let f = open_append "branches" in
-      let allBranches = (!funCount, !curBranches) :: !branches in
-        List.iter (writeFunBranches f) (List.tl (List.rev allBranches));
-        close_out f
-    with x ->
-      prerr_string "Failed to write branches.\n"
+    mapOptional getFirstFuncStmtId cilFile.globals
 
-(* Visitor which walks the CIL AST, printing the (already computed) CFG. *)
-class writeCfgVisitor out firstStmtIdMap =
-object (self)
-  inherit nopCilVisitor
-  val out = out
-  val firstStmtIdMap = firstStmtIdMap
 
-  method writeCfgCall f =
-    if List.mem_assq f firstStmtIdMap then
-      Printf.fprintf out " %d" (List.assq f firstStmtIdMap).sid
-    else
-      Printf.fprintf out " %s" f.vname
-
-  method writeCfgInst i =
-     match i with
-         Call(_, Lval(Var f, _), _, _) -> self#writeCfgCall f
-       | _ -> ()
+(*
+ * The CFG and branches of the file are written to a binary "fragment",
+ * "cfg_fragments/NAME" (with NAME derived from the path of the source
+ * file -- see sourceFileName), which replaces the file's fragment from
+ * any earlier run.  process_cfg merges the fragments of all files,
+ * recomputing only the parts of its output which depend on fragments
+ * that changed.
+ *
+ * A fragment is the four bytes "CRCF", followed by 32-bit big-endian
+ * integers (as written by output_binary_int):
+ *   the version (1),
+ *   the number of names, and then each name as its length and bytes,
+ *   the number of functions, and then for each function:
+ *     its name (as an index into the names), whether it is static (0/1),
+ *     its function id (0 if uninstrumented), its first statement id,
+ *     the number of branch pairs, and then each pair (true, false),
+ *     the number of statements, and then for each statement:
+ *       its id, the number of successors, the successor ids,
+ *       the number of calls, and then each call: the first statement id
+ *         of a function in this file, or -(1 + index of the name).
+ *)
 
-  method vstmt(s) =
-    Printf.fprintf out "%d" s.sid ;
-    List.iter (fun dst -> Printf.fprintf out " %d" dst.sid) s.succs ;
-    (match s.skind with
-         Instr is -> List.iter self#writeCfgInst is
-       | _       -> ()) ;
-    output_string out "\n" ;
-    DoChildren
+let fragmentMagic = "CRCF"
+let fragmentVersion = 1
 
-end
+let fragmentNames : (string, int) Hashtbl.t = Hashtbl.create 64
+let fragmentNameList = ref []
+let fragmentCfg = ref []
+let funIds = ref []
 
-let writeCfg cilFile firstStmtIdMap =
+let internName name =
   try
-    let out = open_append "cfg" in
-    let wcfgv = new writeCfgVisitor out firstStmtIdMap in
-    visitCilFileSameGlobals (wcfgv :> cilVisitor) cilFile ;
-    close_out out
-  with x ->
-    prerr_string "Failed to write CFG.\n"
+    Hashtbl.find fragmentNames name
+  with Not_found ->
+    let idx = Hashtbl.length fragmentNames in
+      Hashtbl.add fragmentNames name idx ;
+      fragmentNameList := name :: !fragmentNameList ;
+      idx
+
+(* The (absolute) name of the source file of 'cilFile'.  CIL parses the
+ * preprocessed file -- a temporary /tmp/cil-*.i, unless cilly is given
+ * --save-temps -- whose first line directive names the source file, as
+ * in:  # 1 "foo.c"  *)
+let sourceFileName cilFile =
+  let directive line =
+    try
+      Scanf.sscanf line "# %d %S" (fun _ name -> Some name)
+    with x ->
+      try
+        Scanf.sscanf line "#line %d %S" (fun _ name -> Some name)
+      with x -> None
+  in
+  let rec firstDirective f n =
+    if n = 0 then
+      cilFile.fileName
+    else
+      match directive (input_line f) with
+          Some name -> name
+        | None -> firstDirective f (n - 1)
+  in
+  let name =
+    try
+      let f = open_in cilFile.fileName in
+      let name = (try firstDirective f 10 with x -> cilFile.fileName) in
+        close_in f ;
+        name
+    with x -> cilFile.fileName
+  in
+    if Filename.is_relative name then
+      Filename.concat (Sys.getcwd ()) name
+    else
+      name
 
-let buildFirstStmtIdMap cilFile =
-  let getFirstFuncStmtId glob =
+let fragmentFileName cilFile =
+  let sanitize c =
+    match c with
+      | 'a'..'z' | 'A'..'Z' | '0'..'9' | '.' | '-' | '_' -> c
+      | _ -> '_'
+  in
+  let buff = Buffer.create 64 in
+    String.iter (fun c -> Buffer.add_char buff (sanitize c))
+                (sourceFileName cilFile) ;
+    "cfg_fragments/" ^ (Buffer.contents buff)
+
+(* Records the (already computed) CFG, before instrumentation adds
+ * statements to it. *)
+let recordFragmentCfg cilFile =
+  let firstStmtIdMap = buildFirstStmtIdMap cilFile in
+  let callTarget i =
+    match i with
+        Call(_, Lval(Var f, _), _, _) ->
+          if List.mem_assq f firstStmtIdMap then
+            Some (List.assq f firstStmtIdMap).sid
+          else
+            Some (-1 - (internName f.vname))
+      | _ -> None
+  in
+  let stmtCfg s =
+    let calls =
+      match s.skind with
+          Instr is -> mapOptional callTarget is
+        | _       -> []
+    in
+      (s.sid, List.map (fun dst -> dst.sid) s.succs, calls)
+  in
+  let funCfg glob =
     match glob with
-      | GFun(f, _) -> Some (f.svar, List.hd f.sbody.bstmts)
+      | GFun (fd, _) ->
+          Some (fd.svar, internName fd.svar.vname,
+                (List.assq fd.svar firstStmtIdMap).sid,
+                List.map stmtCfg fd.sallstmts)
       | _ -> None
   in
-    mapOptional getFirstFuncStmtId cilFile.globals
+    fragmentCfg := mapOptional funCfg cilFile.globals
 
-let writeFirstStmtIdMap firstStmtIdMap =
-  let writeEntry out (f,s) =
-    (* To help avoid "collisions", skip static functions. *)
-    if not (f.vstorage = Static) then
-      Printf.fprintf out "%s %d\n" f.vname s.sid
+let writeFragment cilFile =
+  let allBranches = (!funCount, !curBranches) :: !branches in
+  let funBranches fid =
+    try List.sort compare (List.assoc fid allBranches) with Not_found -> []
   in
-  try
-    let out = open_append "cfg_func_map" in
-    List.iter (writeEntry out) firstStmtIdMap ;
-    close_out out
-  with x ->
-    prerr_string "Failed to write (function, first statement ID) map.\n"
-
-let handleCallEdgesAndWriteCfg cilFile =
-  let stmtMap = buildFirstStmtIdMap cilFile in
-   writeCfg cilFile stmtMap ;
-   writeFirstStmtIdMap stmtMap
+  let fname = fragmentFileName cilFile in
+    try
+      (try Unix.mkdir "cfg_fragments" 0o755 with _ -> ()) ;
+      let out = open_out_bin fname in
+      let writeInt n = output_binary_int out n in
+      let writeList f ls = writeInt (List.length ls) ; List.iter f ls in
+      let writeName name =
+        writeInt (String.length name) ;
+        output_string out name
+      in
+      let writeStmt (sid, succs, calls) =
+        writeInt sid ;
+        writeList writeInt succs ;
+        writeList writeInt calls
+      in
+      let writeFun (f, name, firstSid, stmts) =
+        let fid = (try List.assq f !funIds with Not_found -> 0) in
+          writeInt name ;
+          writeInt (if f.vstorage = Static then 1 else 0) ;
+          writeInt fid ;
+          writeInt firstSid ;
+          writeList (fun (b1, b2) -> writeInt b1 ; writeInt b2)
+                    (if fid > 0 then funBranches fid else []) ;
+          writeList writeStmt stmts
+      in
+        output_string out fragmentMagic ;
+        writeInt fragmentVersion ;
+        writeList writeName (List.rev !fragmentNameList) ;
+        writeList writeFun !fragmentCfg ;
+        close_out out
+    with x ->
+      prerr_string ("Failed to write CFG fragment " ^ fname ^ ".\n")
 
 
 (* Utilities *)
@@ -272,6 +355,225 @@ let hasAddress (_, off) =
     not (containsBitField off)
 
 
+(*
+ * An optional static taint analysis, run just before instrumentation.
+ *
+ * A value is "tainted" if it may be symbolic when the instrumented
+ * program runs -- i.e. if it may depend on a value obtained through
+ * one of the CREST_* input functions.  An expression which is never
+ * tainted is instrumented with a single concrete Load instead of the
+ * full tree of Load's and Apply's, and assignments to an untainted
+ * variable whose address is never taken are not instrumented at all.
+ *
+ * The analysis is flow-insensitive: it computes the set of tainted
+ * variables and of functions which may return tainted values, by
+ * iterating over every instruction in the file until nothing changes.
+ * Memory accessed through pointers is resolved with CIL's points-to
+ * analysis (Ptranal).  Locations which the points-to analysis cannot
+ * name (e.g. the heap) are summarized by a single flag.
+ *
+ * Because CIL is run once per source file, by default the analysis
+ * assumes that code in other files may pass symbolic values to any
+ * non-static function, and may store them in any non-static global or
+ * through any pointer.  With --crestWholeProgram (e.g. when the whole
+ * program is merged into one file with "cilly --merge"), the file is
+ * assumed to be the entire program, so functions it does not define
+ * are uninstrumented and always return concrete values.
+ *)
+
+let taintAnalysis = ref false
+let wholeProgram = ref false
+let inlineInstrumentation = ref false
+
+let taintedVars : (int, unit) Hashtbl.t = Hashtbl.create 1024
+let taintedRets : (int, unit) Hashtbl.t = Hashtbl.create 256
+let taintedMem = ref false
+let taintChanged = ref false
+
+let taintFundecs : (int, fundec) Hashtbl.t = Hashtbl.create 256
+let addrTakenVars = ref []
+let addrTakenFuns = ref []
+
+let isInputFunction f =
+  List.mem f.vname ["__CrestUChar"; "__CrestUShort"; "__CrestUInt";
+                    "__CrestChar";  "__CrestShort";  "__CrestInt"]
+
+let isTaintedVar v = Hashtbl.mem taintedVars v.vid
+
+let taintVar v =
+  if not (isTaintedVar v) then
+    (Hashtbl.add taintedVars v.vid () ;
+     taintChanged := true)
+
+let taintRet f =
+  if not (Hashtbl.mem taintedRets f.vid) then
+    (Hashtbl.add taintedRets f.vid () ;
+     taintChanged := true)
+
+let taintMem () =
+  if not !taintedMem then
+    (taintedMem := true ;
+     taintChanged := true)
+
+(* The variables which pointer 'e' may point to, or None if unknown. *)
+let resolvePointer e =
+  try Some (Ptranal.resolve_exp e) with _ -> None
+
+let rec isTaintedExp e =
+  match e with
+    | Lval lv -> isTaintedLval lv
+    | UnOp (_, e1, _) -> isTaintedExp e1
+    | BinOp (_, e1, e2, _) -> (isTaintedExp e1) || (isTaintedExp e2)
+    | CastE (_, e1) -> isTaintedExp e1
+    (* Anything else (constants, sizeof's, addresses) is instrumented
+     * as a concrete value. *)
+    | _ -> false
+
+and isTaintedLval (host, _) =
+  match host with
+    | Var v -> isTaintedVar v
+    | Mem e ->
+        !taintedMem ||
+        (match resolvePointer e with
+           | Some vs -> List.exists isTaintedVar vs
+           | None -> true)
+
+(* Records that the memory pointed to by 'e' may hold a tainted value. *)
+let taintPointees e =
+  match e with
+    | AddrOf (Var v, _) | StartOf (Var v, _) -> taintVar v
+    | _ ->
+        taintMem () ;
+        (match resolvePointer e with
+           | Some vs -> List.iter taintVar vs
+           | None -> List.iter taintVar !addrTakenVars)
+
+let taintLval (host, _) =
+  match host with
+    | Var v -> taintVar v
+    | Mem e -> taintPointees e
+
+let taintOptLval lv =
+  match lv with
+    | Some lv -> taintLval lv
+    | None -> ()
+
+(* Propagates taint through a call of 'fd' with arguments 'args'. *)
+let taintCall ret fd args =
+  let rec taintFormals formals args =
+    match (formals, args) with
+      | ((v :: vs), (a :: rest)) ->
+          if isTaintedExp a then taintVar v ;
+          taintFormals vs rest
+      | _ -> ()
+  in
+    taintFormals fd.sformals args ;
+    if Hashtbl.mem taintedRets fd.svar.vid then taintOptLval ret
+
+
+class taintVisitor =
+object (self)
+  inherit nopCilVisitor
+
+  val mutable curFunc = dummyFunDec.svar
+
+  method vfunc(f) =
+    if shouldSkipFunction f.svar then
+      SkipChildren
+    else
+      (curFunc <- f.svar ;
+       DoChildren)
+
+  method vstmt(s) =
+    (match s.skind with
+       | Return (Some e, _) when isTaintedExp e -> taintRet curFunc
+       | _ -> ()) ;
+    DoChildren
+
+  method vinst(i) =
+    (match i with
+       | Set (lv, e, _) ->
+           if isTaintedExp e then taintLval lv
+
+       | Call (_, Lval (Var f, NoOffset), args, _) when isInputFunction f ->
+           List.iter taintPointees args
+
+       (* Calls to uninstrumented functions are skipped entirely. *)
+       | Call (_, Lval (Var f, NoOffset), _, _) when shouldSkipFunction f ->
+           ()
+
+       | Call (ret, Lval (Var f, NoOffset), args, _) ->
+           (try
+              taintCall ret (Hashtbl.find taintFundecs f.vid) args
+            with Not_found ->
+              if not !wholeProgram then taintOptLval ret)
+
+       | Call (ret, fexp, args, _) ->
+           let targets =
+             match (try Ptranal.resolve_funptr fexp with _ -> []) with
+               | [] -> !addrTakenFuns
+               | fds -> fds
+           in
+             List.iter (fun fd -> taintCall ret fd args) targets ;
+             if not !wholeProgram then taintOptLval ret
+
+       | _ -> ()) ;
+    SkipChildren
+
+end
+
+
+let initTaint f =
+  let addAddrTaken v =
+    if v.vaddrof then addrTakenVars := v :: !addrTakenVars
+  in
+  let initGlobal glob =
+    match glob with
+      | GVar (v, _, _) | GVarDecl (v, _) when not (isFunctionType v.vtype) ->
+          addAddrTaken v ;
+          if not (!wholeProgram || (v.vstorage = Static)) then taintVar v
+      | GFun (fd, _) ->
+          Hashtbl.replace taintFundecs fd.svar.vid fd ;
+          List.iter addAddrTaken fd.sformals ;
+          List.iter addAddrTaken fd.slocals ;
+          if fd.svar.vaddrof then addrTakenFuns := fd :: !addrTakenFuns ;
+          (* Functions which code in other files can call. *)
+          if not (!wholeProgram ||
+                  ((fd.svar.vstorage = Static) && not fd.svar.vaddrof)) then
+            List.iter taintVar fd.sformals
+      | _ -> ()
+  in
+    iterGlobals f initGlobal ;
+    (* Code in other files can store symbolic values through pointers. *)
+    if not !wholeProgram then
+      (taintMem () ;
+       List.iter taintVar !addrTakenVars)
+
+let computeTaint f =
+  initTaint f ;
+  Ptranal.analyze_file f ;
+  Ptranal.compute_results false ;
+  let tVisitor = new taintVisitor in
+    taintChanged := true ;
+    while !taintChanged do
+      taintChanged := false ;
+      visitCilFileSameGlobals (tVisitor :> cilVisitor) f
+    done
+
+(* True if 'e' is known never to be symbolic. *)
+let isConcreteExp e = !taintAnalysis && not (isTaintedExp e)
+
+(* True if variable 'v' is known never to be symbolic, and is never
+ * accessed through a pointer. *)
+let isConcreteVar v =
+  !taintAnalysis && (not v.vaddrof) && (not (isTaintedVar v))
+
+let isConcreteLval (host, _) =
+  match host with
+    | Var v -> isConcreteVar v
+    | Mem _ -> false
+
+
 class crestInstrumentVisitor f =
   (*
    * Get handles to the instrumentation functions.
@@ -296,15 +598,36 @@ class crestInstrumentVisitor f =
       func
   in
 
-  let loadFunc         = mkInstFunc "Load"  [addrArg; valArg] in
-  let storeFunc        = mkInstFunc "Store" [addrArg] in
-  let clearStackFunc   = mkInstFunc "ClearStack" [] in
-  let apply1Func       = mkInstFunc "Apply1" [opArg; valArg] in
-  let apply2Func       = mkInstFunc "Apply2" [opArg; valArg] in
+  (*
+   * With --crestInline, use the inline variant of an instrumentation
+   * function (see "libcrest/crest_inline.h") if the file defines it.
+   *)
+  let findInlineFunc name =
+    let inlineName = "__Crest" ^ name ^ "Inline" in
+    let rec find globs =
+      match globs with
+        | [] -> None
+        | (GFun (fd, _) :: _) when fd.svar.vname = inlineName -> Some fd.svar
+        | (_ :: rest) -> find rest
+    in
+      find f.globals
+  in
+
+  let mkInlinableFunc name args =
+    match (if !inlineInstrumentation then findInlineFunc name else None) with
+      | Some func -> func
+      | None -> mkInstFunc name args
+  in
+
+  let loadFunc         = mkInlinableFunc "Load"  [addrArg; valArg] in
+  let storeFunc        = mkInlinableFunc "Store" [addrArg] in
+  let clearStackFunc   = mkInlinableFunc "ClearStack" [] in
+  let apply1Func       = mkInlinableFunc "Apply1" [opArg; valArg] in
+  let apply2Func       = mkInlinableFunc "Apply2" [opArg; valArg] in
   let branchFunc       = mkInstFunc "Branch" [bidArg; boolArg] in
   let callFunc         = mkInstFunc "Call" [fidArg] in
   let returnFunc       = mkInstFunc "Return" [] in
-  let handleReturnFunc = mkInstFunc "HandleReturn" [valArg] in
+  let handleReturnFunc = mkInlinableFunc "HandleReturn" [valArg] in
 
   (*
    * Functions to create calls to the above instrumentation functions.
@@ -360,7 +683,7 @@ class crestInstrumentVisitor f =
    * Instrument an expression.
    *)
   let rec instrumentExpr e =
-    if isConstant e then
+    if (isConstant e) || (isConcreteExp e) then
       [mkLoad noAddr e]
     else
       match e with
@@ -422,6 +745,9 @@ object (self)
    *)
   method vinst(i) =
     match i with
+      (* Skip assignments to variables which are never symbolic. *)
+      | Set (lv, _, _) when isConcreteLval lv -> SkipChildren
+
       | Set (lv, e, _) ->
           if (isSymbolicType (typeOf e)) && (hasAddress lv) then
             (self#queueInstr (instrumentExpr e) ;
@@ -438,7 +764,8 @@ object (self)
           let argsToInst = List.filter isSymbolicExp args in
             self#queueInstr (concatMap instrumentExpr argsToInst) ;
             (match ret with
-               | Some lv when ((isSymbolicLval lv) && (hasAddress lv)) ->
+               | Some lv when ((isSymbolicLval lv) && (hasAddress lv)
+                               && not (isConcreteLval lv)) ->
                    ChangeTo [i ;
                              mkHandleReturn (Lval lv) ;
                              mkStore (addressOf lv)]
@@ -460,6 +787,7 @@ object (self)
       let (_, _, isVarArgs, _) = splitFunctionType f.svar.vtype in
       let paramsToInst = List.filter isSymbolic f.sformals in
         addFunction () ;
+        funIds := (f.svar, !funCount) :: !funIds ;
         if (not isVarArgs) then
           prependToBlock (List.rev_map instParam paramsToInst) f.sbody ;
         prependToBlock [mkCall !funCount] f.sbody ;
@@ -488,7 +816,14 @@ let feature : featureDescr =
   { fd_name = "CrestInstrument";
     fd_enabled = ref false;
     fd_description = "instrument a program for use with CREST";
-    fd_extraopt = [];
+    fd_extraopt = [
+      ("--crestTaint", Arg.Set taintAnalysis,
+       " skip instrumenting expressions which are never symbolic");
+      ("--crestWholeProgram", Arg.Set wholeProgram,
+       " assume the file is the whole program (for --crestTaint)");
+      ("--crestInline", Arg.Set inlineInstrumentation,
+       " use the inline instrumentation functions, where defined")
+    ];
     fd_post_check = true;
     fd_doit =
       function (f: file) ->
@@ -515,19 +850,20 @@ let feature : featureDescr =
           readFunCount () ;
           (* Compute the control-flow graph. *)
           Cfg.computeFileCFG f ;
-          (* Adds function calls to the CFG, by building a map from
-           * function names to the first statements in those functions
-           * and by explicitly adding edges for calls to functions
-           * defined in this file. *)
-          handleCallEdgesAndWriteCfg f ;
+          (* Records the CFG for the file's fragment, including calls --
+           * to the first statements of functions defined in this file,
+           * and by name to all other functions. *)
+          recordFragmentCfg f ;
+          (* Optionally find the expressions which are never symbolic. *)
+          if !taintAnalysis then computeTaint f ;
           (* Finally instrument the program. *)
 	  (let instVisitor = new crestInstrumentVisitor f in
              visitCilFileSameGlobals (instVisitor :> cilVisitor) f) ;
           (* Add a function to initialize the instrumentation library. *)
           addCrestInitializer f ;
-          (* Write the ID and statement counts, the branches. *)
+          (* Write the ID and statement counts, and the CFG fragment. *)
           writeIdCount () ;
           writeStmtCount () ;
           writeFunCount () ;
-          writeBranches ());
+          writeFragment f);
   }
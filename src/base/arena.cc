@@ -0,0 +1,45 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include "base/arena.h"
+
+namespace crest {
+
+namespace {
+
+// Size of each block of objects.
+const size_t kBlockSize = 64 * 1024;
+
+// Alignment of each object.
+const size_t kAlignment = 16;
+
+}  // namespace
+
+
+FixedArena::FixedArena(size_t object_size)
+  : object_size_(object_size), free_list_(NULL), next_(NULL), end_(NULL) {
+  if (object_size_ < sizeof(FreeNode))
+    object_size_ = sizeof(FreeNode);
+  object_size_ = (object_size_ + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+FixedArena::~FixedArena() {
+  for (size_t i = 0; i < blocks_.size(); i++)
+    delete [] blocks_[i];
+}
+
+void FixedArena::NewBlock() {
+  const size_t num_objects = (kBlockSize + object_size_ - 1) / object_size_;
+  next_ = new char[num_objects * object_size_];
+  end_ = next_ + num_objects * object_size_;
+  blocks_.push_back(next_);
+}
+
+}  // namespace crest
@@ -0,0 +1,76 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_ARENA_H__
+#define BASE_ARENA_H__
+
+#include <stddef.h>
+#include <vector>
+
+using std::vector;
+
+namespace crest {
+
+// An allocator for objects of a single, fixed size.
+//
+// Objects are carved out of large blocks with a bump pointer, and freed
+// objects are kept on a free list for re-use.  Memory is only returned
+// when the whole arena is destroyed (or the process exits), so
+// allocating and freeing short-lived objects costs a few instructions
+// rather than a trip through malloc/free.
+//
+// Not thread-safe.
+class FixedArena {
+ public:
+  explicit FixedArena(size_t object_size);
+  ~FixedArena();
+
+  void* Allocate() {
+    if (free_list_) {
+      FreeNode* n = free_list_;
+      free_list_ = n->next;
+      return n;
+    }
+    if (next_ == end_)
+      NewBlock();
+    void* p = next_;
+    next_ += object_size_;
+    return p;
+  }
+
+  void Free(void* p) {
+    if (p) {
+      FreeNode* n = static_cast<FreeNode*>(p);
+      n->next = free_list_;
+      free_list_ = n;
+    }
+  }
+
+ private:
+  struct FreeNode {
+    FreeNode* next;
+  };
+
+  size_t object_size_;
+  FreeNode* free_list_;
+  char* next_;
+  char* end_;
+  vector<char*> blocks_;
+
+  void NewBlock();
+
+  // Disallow copying.
+  FixedArena(const FixedArena&);
+  void operator=(const FixedArena&);
+};
+
+}  // namespace crest
+
+#endif  // BASE_ARENA_H__
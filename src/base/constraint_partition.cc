@@ -0,0 +1,121 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <limits>
+
+#include "base/constraint_partition.h"
+
+using std::numeric_limits;
+using std::sort;
+using std::swap;
+
+namespace crest {
+
+const var_t ConstraintPartition::kNoVar;
+
+ConstraintPartition::ConstraintPartition() { }
+
+void ConstraintPartition::Swap(ConstraintPartition& p) {
+  first_var_.swap(p.first_var_);
+  parent_.swap(p.parent_);
+  rank_.swap(p.rank_);
+  time_.swap(p.time_);
+  members_.swap(p.members_);
+}
+
+void ConstraintPartition::Clear() {
+  first_var_.clear();
+  parent_.clear();
+  rank_.clear();
+  time_.clear();
+  // (The lists keep their storage, for the next path.)
+  for (size_t i = 0; i < members_.size(); i++) {
+    members_[i].clear();
+  }
+}
+
+void ConstraintPartition::Add(const vector<var_t>& vars) {
+  const size_t idx = first_var_.size();
+  if (vars.empty()) {
+    first_var_.push_back(kNoVar);
+    return;
+  }
+  first_var_.push_back(vars[0]);
+
+  // Make sure every variable is in the union-find.
+  for (size_t i = 0; i < vars.size(); i++) {
+    while (parent_.size() <= vars[i]) {
+      parent_.push_back(parent_.size());
+      rank_.push_back(0);
+      time_.push_back(0);
+    }
+  }
+  if (members_.size() < parent_.size()) {
+    members_.resize(parent_.size());
+  }
+
+  // Union the variables' partitions (by rank), stamping the new links
+  // with idx.
+  var_t root = Find(vars[0], idx);
+  for (size_t i = 1; i < vars.size(); i++) {
+    var_t r = Find(vars[i], idx);
+    if (r == root)
+      continue;
+    if (rank_[r] > rank_[root])
+      swap(r, root);
+    if (rank_[r] == rank_[root])
+      rank_[root]++;
+    parent_[r] = root;
+    time_[r] = idx;
+
+    // Merge the smaller list of constraints into the larger.
+    if (members_[r].size() > members_[root].size())
+      members_[r].swap(members_[root]);
+    members_[root].insert(members_[root].end(),
+                          members_[r].begin(), members_[r].end());
+    members_[r].clear();
+  }
+  members_[root].push_back(idx);
+}
+
+void ConstraintPartition::DependentConstraints(size_t idx,
+                                               vector<size_t>* slice) const {
+  slice->clear();
+
+  const var_t v = first_var_[idx];
+  if (v == kNoVar) {
+    // A constraint with no variables depends on nothing else.
+    slice->push_back(idx);
+    return;
+  }
+
+  // The partition containing constraint idx now contains the partition
+  // it was in when the first idx+1 constraints had been added.
+  const var_t root = Find(v, idx);
+  const vector<size_t>& members =
+    members_[Find(v, numeric_limits<size_t>::max())];
+  for (size_t i = 0; i < members.size(); i++) {
+    const size_t j = members[i];
+    if ((j <= idx) && (Find(first_var_[j], idx) == root)) {
+      slice->push_back(j);
+    }
+  }
+  sort(slice->begin(), slice->end());
+}
+
+var_t ConstraintPartition::Find(var_t v, size_t time) const {
+  while ((parent_[v] != v) && (time_[v] <= time)) {
+    v = parent_[v];
+  }
+  return v;
+}
+
+}  // namespace crest
@@ -0,0 +1,65 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_CONSTRAINT_PARTITION_H__
+#define BASE_CONSTRAINT_PARTITION_H__
+
+#include <vector>
+
+#include "base/basic_types.h"
+
+using std::vector;
+
+namespace crest {
+
+// The partition of a path's constraints by shared variables, grown one
+// constraint at a time (see SymbolicPath and ExecutionView).
+//
+// It is a union-find over the variables.  Links are stamped with the
+// index of the constraint that made them and paths are never compressed,
+// so the partition as of any prefix of the constraints can be recovered.
+class ConstraintPartition {
+ public:
+  ConstraintPartition();
+
+  void Swap(ConstraintPartition& p);
+  void Clear();
+
+  // The number of constraints added so far.
+  size_t size() const { return first_var_.size(); }
+
+  // Adds the next constraint, over the (distinct) variables 'vars'.
+  void Add(const vector<var_t>& vars);
+
+  // Sets *slice to the (sorted) indices of the constraints among the
+  // first idx+1 on which constraint idx depends -- i.e. those connected
+  // to it through shared variables.  Takes time roughly proportional to
+  // the size of constraint idx's partition, rather than to idx.
+  void DependentConstraints(size_t idx, vector<size_t>* slice) const;
+
+ private:
+  static const var_t kNoVar = ~0u;
+
+  // The first variable of each constraint, or kNoVar if it has none.
+  vector<var_t> first_var_;
+
+  vector<var_t> parent_;
+  vector<unsigned char> rank_;
+  vector<size_t> time_;
+  // The constraints in each partition, indexed by its current root.
+  // (May be longer than parent_, after Clear.)
+  vector< vector<size_t> > members_;
+
+  var_t Find(var_t v, size_t time) const;
+};
+
+}  // namespace crest
+
+#endif  // BASE_CONSTRAINT_PARTITION_H__
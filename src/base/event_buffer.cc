@@ -0,0 +1,143 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base/event_buffer.h"
+#include "base/symbolic_interpreter.h"
+
+namespace crest {
+
+namespace {
+
+bool WriteAll(int fd, const char* buff, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buff, len);
+    if (n <= 0)
+      return false;
+    buff += n;
+    len -= n;
+  }
+  return true;
+}
+
+}  // namespace
+
+
+void ReplayEvents(const Event* begin, const Event* end,
+                  SymbolicInterpreter* si) {
+  for (const Event* ev = begin; ev != end; ++ev) {
+    switch (ev->kind) {
+    case events::LOAD:
+      si->Load(ev->id, ev->addr, ev->value);
+      break;
+    case events::STORE:
+      si->Store(ev->id, ev->addr);
+      break;
+    case events::CLEAR_STACK:
+      si->ClearStack(ev->id);
+      break;
+    case events::APPLY_UNARY:
+      si->ApplyUnaryOp(ev->id, static_cast<unary_op_t>(ev->op), ev->value);
+      break;
+    case events::APPLY_BINARY:
+      si->ApplyBinaryOp(ev->id, static_cast<binary_op_t>(ev->op), ev->value);
+      break;
+    case events::APPLY_COMPARE:
+      si->ApplyCompareOp(ev->id, static_cast<compare_op_t>(ev->op), ev->value);
+      break;
+    case events::CALL:
+      si->Call(ev->id, static_cast<function_id_t>(ev->addr));
+      break;
+    case events::RETURN:
+      si->Return(ev->id);
+      break;
+    case events::HANDLE_RETURN:
+      si->HandleReturn(ev->id, ev->value);
+      break;
+    case events::BRANCH:
+      si->Branch(ev->id, static_cast<branch_id_t>(ev->addr), ev->value != 0);
+      break;
+    case events::NEW_INPUT:
+      si->NewInput(static_cast<type_t>(ev->op), ev->addr);
+      break;
+    }
+  }
+}
+
+
+bool ReadEventLog(const char* fname, vector<Event>* events) {
+  FILE* f = fopen(fname, "rb");
+  if (!f)
+    return false;
+
+  char magic[sizeof(kEventLogMagic)];
+  unsigned int header[2];
+  if ((fread(magic, sizeof(magic), 1, f) != 1)
+      || memcmp(magic, kEventLogMagic, sizeof(magic))
+      || (fread(header, sizeof(header), 1, f) != 1)
+      || (header[0] != kEventLogVersion) || (header[1] != sizeof(Event))) {
+    fclose(f);
+    return false;
+  }
+
+  Event buff[1024];
+  size_t n;
+  while ((n = fread(buff, sizeof(Event), 1024, f)) > 0) {
+    events->insert(events->end(), buff, buff + n);
+  }
+  bool success = !ferror(f);
+  fclose(f);
+  return success;
+}
+
+
+bool EventBuffer::OpenLog(const char* fname) {
+  log_fd_ = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (log_fd_ < 0)
+    return false;
+
+  unsigned int header[2] = { kEventLogVersion, sizeof(Event) };
+  if (!WriteAll(log_fd_, kEventLogMagic, sizeof(kEventLogMagic))
+      || !WriteAll(log_fd_, (const char*)header, sizeof(header))) {
+    close(log_fd_);
+    log_fd_ = -1;
+    return false;
+  }
+  return true;
+}
+
+
+void EventBuffer::LogInput(type_t type, addr_t addr, value_t value) {
+  if (log_fd_ < 0)
+    return;
+
+  Event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.kind = events::NEW_INPUT;
+  ev.op = type;
+  ev.addr = addr;
+  ev.value = value;
+  WriteLog(&ev, 1);
+}
+
+
+void EventBuffer::WriteLog(const Event* events, size_t num_events) {
+  // Stop logging on failure, rather than write a corrupt log.
+  if (!WriteAll(log_fd_, (const char*)events, num_events * sizeof(Event))) {
+    close(log_fd_);
+    log_fd_ = -1;
+  }
+}
+
+}  // namespace crest
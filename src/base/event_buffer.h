@@ -0,0 +1,124 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_EVENT_BUFFER_H__
+#define BASE_EVENT_BUFFER_H__
+
+#include <vector>
+
+#include "base/basic_types.h"
+
+using std::vector;
+
+namespace crest {
+
+class SymbolicInterpreter;
+
+// When an instrumented program is run with kBatchEventsEnv set in its
+// environment, the instrumentation functions (see libcrest/crest.h) do
+// not call into the SymbolicInterpreter directly.  Instead, each call is
+// appended to an EventBuffer as a fixed-size Event, and the buffered
+// events are handed to the interpreter a batch at a time, in one tight
+// loop over contiguous memory.
+//
+// If kEventLogEnv is set, to a file name, the program also runs in batch
+// mode and writes all of its events to that file: the four bytes of
+// kEventLogMagic, kEventLogVersion and sizeof(Event) (as unsigned int's),
+// and then the raw Event's.  Replaying the log (see ReplayEvents and
+// tools/replay_events) rebuilds the program's SymbolicExecution without
+// running the program.
+
+static const char kBatchEventsEnv[] = "CREST_BATCH_EVENTS";
+static const char kEventLogEnv[] = "CREST_EVENT_LOG";
+
+static const char kEventLogMagic[4] = { 'C', 'R', 'E', 'V' };
+static const unsigned int kEventLogVersion = 1;
+
+namespace events {
+enum event_kind_t { LOAD, STORE, CLEAR_STACK,
+                    APPLY_UNARY, APPLY_BINARY, APPLY_COMPARE,
+                    CALL, RETURN, HANDLE_RETURN, BRANCH,
+                    NEW_INPUT };
+}
+using events::event_kind_t;
+
+// One call to an instrumentation function.  (The fields which are not
+// used by a kind of event are zero.)  The padding after 'op' is an
+// explicit field, also zero, so that an event log holds no stray bytes.
+struct Event {
+  unsigned char kind;  // An event_kind_t.
+  unsigned char op;    // The unary_op_t, binary_op_t, or compare_op_t.
+  unsigned short reserved;
+  id_t id;
+  addr_t addr;         // For BRANCH, the branch id; for CALL, the function id.
+  value_t value;       // For BRANCH, the (boolean) branch taken.
+};
+
+// Hands the events in [begin, end) to 'si', in order.
+//
+// NEW_INPUT events (with op the type_t of the input, and value its
+// concrete value) only appear in event logs -- a running program must
+// call SymbolicInterpreter::NewInput directly, for the input's value.
+void ReplayEvents(const Event* begin, const Event* end,
+                  SymbolicInterpreter* si);
+
+// Reads an event log, appending its events to *events.  Returns false
+// on failure.
+bool ReadEventLog(const char* fname, vector<Event>* events);
+
+class EventBuffer {
+ public:
+  explicit EventBuffer(SymbolicInterpreter* si)
+    : si_(si), log_fd_(-1), num_events_(0) { }
+
+  // Starts writing all events to the event log 'fname'.  Returns false
+  // on failure.
+  bool OpenLog(const char* fname);
+
+  void Append(event_kind_t kind, unsigned char op, id_t id,
+              addr_t addr, value_t value) {
+    if (num_events_ == kCapacity)
+      Flush();
+    Event* ev = &events_[num_events_++];
+    ev->kind = kind;
+    ev->op = op;
+    ev->reserved = 0;
+    ev->id = id;
+    ev->addr = addr;
+    ev->value = value;
+  }
+
+  // Hands all buffered events to the interpreter (and the log).
+  void Flush() {
+    if (log_fd_ >= 0)
+      WriteLog(events_, num_events_);
+    ReplayEvents(events_, events_ + num_events_, si_);
+    num_events_ = 0;
+  }
+
+  // Records a NEW_INPUT event in the log, if any.  (The buffer must have
+  // been flushed first.)
+  void LogInput(type_t type, addr_t addr, value_t value);
+
+ private:
+  // 4096 events of 24 bytes, to stay within a typical L2 cache.
+  static const unsigned int kCapacity = 4096;
+
+  SymbolicInterpreter* si_;
+  int log_fd_;
+  unsigned int num_events_;
+  Event events_[kCapacity];
+
+  void WriteLog(const Event* events, size_t num_events);
+};
+
+}  // namespace crest
+
+#endif  // BASE_EVENT_BUFFER_H__
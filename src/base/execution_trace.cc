@@ -0,0 +1,140 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+#include "base/execution_trace.h"
+#include "base/symbolic_predicate.h"
+#include "base/varint.h"
+
+using std::make_pair;
+
+namespace crest {
+
+TraceWriter::TraceWriter()
+  : started_(false), num_vars_(0), num_branches_(0), num_constraints_(0),
+    last_branch_(0) { }
+
+
+void TraceWriter::Append(const SymbolicExecution& ex, string* s) {
+  if (!started_) {
+    s->append(kTraceMagic, sizeof(kTraceMagic));
+    AppendVarint(s, kTraceVersion);
+    started_ = true;
+  }
+
+  // New input variables (which are numbered consecutively from zero).
+  for (; num_vars_ < ex.vars().size(); num_vars_++) {
+    map<var_t,type_t>::const_iterator it = ex.vars().find(num_vars_);
+    assert(it != ex.vars().end());
+    AppendVarint(s, kTraceVar | (static_cast<unsigned long long>(it->second) << 2));
+    AppendVarint(s, ZigZag(ex.inputs()[num_vars_]));
+  }
+
+  // New branches.
+  const vector<branch_id_t>& branches = ex.path().branches();
+  const vector<size_t>& idx = ex.path().constraints_idx();
+  for (; num_branches_ < branches.size(); num_branches_++) {
+    const branch_id_t bid = branches[num_branches_];
+    const unsigned long long delta =
+      ZigZag(static_cast<long long>(bid) - last_branch_) << 2;
+    last_branch_ = bid;
+
+    if ((num_constraints_ >= idx.size()) || (idx[num_constraints_] != num_branches_)) {
+      AppendVarint(s, kTraceBranch | delta);
+      continue;
+    }
+
+    const SymbolicPred& pred = *ex.path().constraints()[num_constraints_++];
+    AppendVarint(s, kTraceConstraint | delta);
+    s->push_back(static_cast<char>(pred.op()));
+    tmp_.clear();
+    pred.expr().Serialize(&tmp_);
+    pair<map<string,unsigned int>::iterator,bool> res =
+      exprs_.insert(make_pair(tmp_, exprs_.size() + 1));
+    if (res.second) {
+      AppendVarint(s, 0);
+      s->append(tmp_);
+    } else {
+      AppendVarint(s, res.first->second);
+    }
+  }
+}
+
+
+void TraceWriter::Finish(string* s) {
+  AppendVarint(s, kTraceEnd);
+}
+
+
+bool ReadTrace(istream& s, SymbolicExecution* ex) {
+  char magic[sizeof(kTraceMagic)];
+  s.read(magic, sizeof(magic));
+  unsigned long long x;
+  if (s.fail() || memcmp(magic, kTraceMagic, sizeof(magic))
+      || !ReadVarint(s, &x) || (x != kTraceVersion))
+    return false;
+
+  vector<SymbolicExpr> exprs;
+  branch_id_t bid = 0;
+  for (;;) {
+    // As in ExecutionView::Index, a trace cut short ends with the last
+    // complete record.
+    if (!ReadVarint(s, &x))
+      return s.eof();
+
+    switch (x & 3) {
+    case kTraceEnd:
+      return true;
+
+    case kTraceVar: {
+      unsigned long long val;
+      if (!ReadVarint(s, &val))
+        return s.eof();
+      var_t v = ex->vars().size();
+      ex->mutable_vars()->insert(make_pair(v, static_cast<type_t>(x >> 2)));
+      ex->mutable_inputs()->push_back(UnZigZag(val));
+      break;
+    }
+
+    case kTraceBranch:
+      bid += UnZigZag(x >> 2);
+      ex->mutable_path()->Push(bid);
+      break;
+
+    case kTraceConstraint: {
+      bid += UnZigZag(x >> 2);
+      int op = s.get();
+      unsigned long long k;
+      if ((op == EOF) || !ReadVarint(s, &k))
+        return s.eof();
+      if (k > exprs.size())
+        return false;
+      if (k == 0) {
+        exprs.push_back(SymbolicExpr());
+        if (!exprs.back().Parse(s))
+          return s.eof();
+        k = exprs.size();
+      }
+      SymbolicPred* pred =
+        new SymbolicPred(static_cast<compare_op_t>(op),
+                         new SymbolicExpr(exprs[k-1]));
+      ex->mutable_path()->Push(bid, pred);
+      break;
+    }
+    }
+  }
+}
+
+}  // namespace crest
@@ -0,0 +1,93 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef BASE_EXECUTION_TRACE_H__
+#define BASE_EXECUTION_TRACE_H__
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_execution.h"
+#include "base/symbolic_expression.h"
+
+using std::istream;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// The binary format in which executions are passed from the program
+// under test to run_crest (see SymbolicExecution::Serialize).
+//
+// A trace is the magic bytes "CRTR", a varint format version, and then a
+// sequence of records, each starting with a varint whose low two bits
+// are a tag:
+//   kTraceEnd         -- the end of the trace.
+//   kTraceVar         -- the next input variable.  The rest of the
+//                        leading varint is its type, and a ZigZag
+//                        varint with its value follows.
+//   kTraceBranch      -- the next branch, without a constraint.  The rest
+//                        of the leading varint is the ZigZag-coded
+//                        difference from the previous branch ID.
+//   kTraceConstraint  -- as kTraceBranch, but the branch has a constraint:
+//                        its operator (one byte), then a varint k.  If k
+//                        is zero, the expression follows (see
+//                        SymbolicExpr::Serialize) and is given the next
+//                        number; otherwise it is the k-th such expression.
+// (All integers are LEB128 varints -- see base/varint.h.)  Thus, a trace
+// can be written incrementally as the execution proceeds, and a trace
+// cut short without kTraceEnd still holds every complete record.
+static const char kTraceMagic[4] = { 'C', 'R', 'T', 'R' };
+static const unsigned int kTraceVersion = 1;
+
+enum TraceTag {
+  kTraceEnd = 0,
+  kTraceVar = 1,
+  kTraceBranch = 2,
+  kTraceConstraint = 3
+};
+
+// Writes the trace of a growing execution, a piece at a time.
+class TraceWriter {
+ public:
+  TraceWriter();
+
+  // Appends to 's' the records for the variables and branches added to
+  // 'ex' since the last call (preceded, on the first call, by the magic
+  // and version).
+  void Append(const SymbolicExecution& ex, string* s);
+
+  // Appends the end-of-trace record.
+  void Finish(string* s);
+
+ private:
+  bool started_;
+  size_t num_vars_;
+  size_t num_branches_;
+  size_t num_constraints_;
+  branch_id_t last_branch_;
+
+  // The number of each expression written so far, by its encoding.
+  map<string,unsigned int> exprs_;
+  string tmp_;
+};
+
+// Reads a trace into (empty) 'ex'.  A truncated trace (e.g. from a
+// program which crashed) is read up to its last complete record.
+bool ReadTrace(istream& s, SymbolicExecution* ex);
+
+}  // namespace crest
+
+#endif  // BASE_EXECUTION_TRACE_H__
@@ -0,0 +1,290 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <utility>
+
+#include "base/execution_trace.h"
+#include "base/execution_view.h"
+#include "base/varint.h"
+
+using std::make_pair;
+using std::swap;
+
+namespace crest {
+
+namespace {
+
+// Advances *p past an expression (see SymbolicExpr::Serialize) without
+// building it, appending its variables to 'vars' if not NULL.
+bool ScanExpr(const char** p, const char* end, vector<var_t>* vars) {
+  unsigned long long len, x;
+  if (!DecodeVarint(p, end, &len) || !DecodeVarint(p, end, &x))
+    return false;
+  var_t v = 0;
+  for (unsigned long long i = 0; i < len; i++) {
+    if (!DecodeVarint(p, end, &x))
+      return false;
+    v += x;
+    if (vars)
+      vars->push_back(v);
+    if (!DecodeVarint(p, end, &x))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+
+ExecutionView::ExecutionView()
+  : data_(NULL), size_(0), mapped_(false), trace_size_(0) { }
+
+ExecutionView::~ExecutionView() {
+  Close();
+}
+
+
+bool ExecutionView::Open(const string& file) {
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    Close();
+    return false;
+  }
+  bool success = Open(fd);
+  close(fd);
+  return success;
+}
+
+
+bool ExecutionView::Open(int fd) {
+  Close();
+
+  struct stat st;
+  if (fstat(fd, &st) || (st.st_size == 0))
+    return false;
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    return false;
+  data_ = static_cast<const char*>(data);
+  size_ = st.st_size;
+  mapped_ = true;
+
+  if (!Index()) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+
+void ExecutionView::Detach() {
+  if (!mapped_)
+    return;
+  buf_.assign(data_, data_ + size_);
+  munmap(const_cast<char*>(data_), size_);
+  data_ = &buf_.front();
+  mapped_ = false;
+}
+
+
+void ExecutionView::Close() {
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+    mapped_ = false;
+  }
+  data_ = NULL;
+  size_ = 0;
+  trace_size_ = 0;
+  // (The vectors keep their storage, for the view's next trace.)
+  buf_.clear();
+  vars_.clear();
+  inputs_.clear();
+  branches_.clear();
+  constraints_idx_.clear();
+  ops_.clear();
+  exprs_.clear();
+  expr_idx_.clear();
+  partition_.Clear();
+}
+
+
+void ExecutionView::Swap(ExecutionView& v) {
+  swap(data_, v.data_);
+  swap(size_, v.size_);
+  swap(mapped_, v.mapped_);
+  buf_.swap(v.buf_);
+  swap(trace_size_, v.trace_size_);
+  vars_.swap(v.vars_);
+  inputs_.swap(v.inputs_);
+  branches_.swap(v.branches_);
+  constraints_idx_.swap(v.constraints_idx_);
+  ops_.swap(v.ops_);
+  exprs_.swap(v.exprs_);
+  expr_idx_.swap(v.expr_idx_);
+  partition_.Swap(v.partition_);
+}
+
+
+bool ExecutionView::Index() {
+  const char* p = data_;
+  const char* const end = data_ + size_;
+  unsigned long long x;
+
+  if ((size_ < sizeof(kTraceMagic))
+      || memcmp(p, kTraceMagic, sizeof(kTraceMagic)))
+    return false;
+  p += sizeof(kTraceMagic);
+  if (!DecodeVarint(&p, end, &x) || (x != kTraceVersion))
+    return false;
+
+  branch_id_t bid = 0;
+  for (;;) {
+    // A trace cut short (e.g. by a crash of the program) ends with the
+    // last complete record; otherwise, a record which cannot be decoded
+    // makes the trace malformed.
+    trace_size_ = p - data_;
+    if (p == end)
+      return true;
+    if (!DecodeVarint(&p, end, &x))
+      return (p == end);
+
+    switch (x & 3) {
+    case kTraceEnd:
+      return true;
+
+    case kTraceVar: {
+      unsigned long long val;
+      if (!DecodeVarint(&p, end, &val))
+        return (p == end);
+      vars_.insert(make_pair(static_cast<var_t>(inputs_.size()),
+                             static_cast<type_t>(x >> 2)));
+      inputs_.push_back(UnZigZag(val));
+      break;
+    }
+
+    case kTraceBranch:
+      bid += UnZigZag(x >> 2);
+      branches_.push_back(bid);
+      break;
+
+    case kTraceConstraint: {
+      bid += UnZigZag(x >> 2);
+      unsigned long long k;
+      if (p == end)
+        return true;
+      compare_op_t op = static_cast<compare_op_t>(*p++);
+      if (!DecodeVarint(&p, end, &k))
+        return (p == end);
+      if (k > exprs_.size())
+        return false;
+      if (k == 0) {
+        // Skip over the new expression.
+        const char* start = p;
+        if (!ScanExpr(&p, end, NULL))
+          return (p == end);
+        exprs_.push_back(make_pair(start - data_, p - start));
+        k = exprs_.size();
+      }
+      constraints_idx_.push_back(branches_.size());
+      ops_.push_back(op);
+      expr_idx_.push_back(k - 1);
+      branches_.push_back(bid);
+      break;
+    }
+    }
+  }
+}
+
+
+void ExecutionView::DependentConstraints(size_t idx,
+                                         vector<size_t>* slice) const {
+  for (size_t i = partition_.size(); i <= idx; i++) {
+    const char* p = expr_data(i);
+    tmp_vars_.clear();
+    bool success = ScanExpr(&p, data_ + size_, &tmp_vars_);
+    assert(success);
+    partition_.Add(tmp_vars_);
+  }
+  partition_.DependentConstraints(idx, slice);
+}
+
+
+void ExecutionView::DecodeExpr(size_t i, SymbolicExpr* e) const {
+  const char* p = expr_data(i);
+  bool success = e->Parse(&p, data_ + size_);
+  assert(success);
+}
+
+
+SymbolicPred* ExecutionView::NewPred(size_t i) const {
+  SymbolicExpr* e = new SymbolicExpr();
+  DecodeExpr(i, e);
+  return new SymbolicPred(ops_[i], e);
+}
+
+
+void ExecutionView::Materialize(SymbolicExecution* ex) const {
+  SymbolicExecution empty;
+  ex->Swap(empty);
+
+  *ex->mutable_vars() = vars_;
+  *ex->mutable_inputs() = inputs_;
+  SymbolicPath* path = ex->mutable_path();
+  size_t j = 0;
+  for (size_t i = 0; i < branches_.size(); i++) {
+    if ((j < constraints_idx_.size()) && (constraints_idx_[j] == i)) {
+      path->Push(branches_[i], NewPred(j++));
+    } else {
+      path->Push(branches_[i]);
+    }
+  }
+}
+
+
+void ExecutionView::Serialize(string* s) const {
+  if (trace_size_ == 0) {
+    // An empty view (e.g. of an execution which timed out).
+    SymbolicExecution().Serialize(s);
+    return;
+  }
+  s->append(data_, trace_size_);
+  AppendVarint(s, kTraceEnd);
+}
+
+
+bool ExecutionView::Parse(istream& s) {
+  Close();
+
+  SymbolicExecution ex;
+  if (!ex.Parse(s))
+    return false;
+  string trace;
+  ex.Serialize(&trace);
+  buf_.assign(trace.begin(), trace.end());
+  data_ = &buf_.front();
+  size_ = buf_.size();
+
+  if (!Index()) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace crest
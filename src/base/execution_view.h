@@ -0,0 +1,143 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef BASE_EXECUTION_VIEW_H__
+#define BASE_EXECUTION_VIEW_H__
+
+#include <istream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/constraint_partition.h"
+#include "base/symbolic_execution.h"
+#include "base/symbolic_expression.h"
+#include "base/symbolic_predicate.h"
+
+using std::istream;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// A read-only view of an execution trace (see base/execution_trace.h),
+// mapped into memory rather than read through an istream.
+//
+// Opening a view makes a single pass over the mapped trace, decoding the
+// inputs, the branches and the constraint indices, but only noting where
+// each constraint's expression is (skipping over it without building
+// it).  Expressions are decoded on demand -- a search decodes only the
+// constraints in the slice it solves -- so following a path allocates no
+// SymbolicPred or SymbolicExpr at all.
+//
+// A mapped view must be detached (see Detach) or closed before the trace
+// file is rewritten (e.g. by the next run of the program), as the mapping
+// would then be invalid.
+class ExecutionView {
+ public:
+  ExecutionView();
+  ~ExecutionView();
+
+  // Maps and indexes the trace in 'file', or in the open file 'fd'.
+  // Returns false (leaving the view empty) if the trace is missing or
+  // malformed.  A truncated trace (e.g. from a program which crashed)
+  // is read up to its last complete record.
+  bool Open(const string& file);
+  bool Open(int fd);
+
+  // Copies the trace out of its mapping into memory owned by the view
+  // (reusing the buffer of any earlier trace), so that the view stays
+  // valid after the trace file is rewritten.
+  void Detach();
+
+  // Unmaps the trace, leaving the view empty.
+  void Close();
+
+  void Swap(ExecutionView& v);
+
+  const map<var_t,type_t>& vars() const { return vars_; }
+  const vector<value_t>& inputs() const { return inputs_; }
+  const vector<branch_id_t>& branches() const { return branches_; }
+  const vector<size_t>& constraints_idx() const { return constraints_idx_; }
+
+  size_t num_constraints() const { return constraints_idx_.size(); }
+  compare_op_t op(size_t i) const { return ops_[i]; }
+
+  // The encoding of the i-th constraint's expression (see
+  // SymbolicExpr::Serialize), in the trace.
+  const char* expr_data(size_t i) const {
+    return data_ + exprs_[expr_idx_[i]].first;
+  }
+  size_t expr_size(size_t i) const { return exprs_[expr_idx_[i]].second; }
+
+  // Returns true if the i-th and j-th constraints are identical.  (Each
+  // distinct expression is written to the trace only once.)
+  bool Equal(size_t i, size_t j) const {
+    return (ops_[i] == ops_[j]) && (expr_idx_[i] == expr_idx_[j]);
+  }
+
+  // As SymbolicPath::DependentConstraints.  Only the variables of the
+  // constraints are decoded, to extend the partition as far as 'idx'.
+  void DependentConstraints(size_t idx, vector<size_t>* slice) const;
+
+  // Decodes the expression of the i-th constraint into 'e'.
+  void DecodeExpr(size_t i, SymbolicExpr* e) const;
+
+  // Returns (a new copy of) the i-th constraint.
+  SymbolicPred* NewPred(size_t i) const;
+
+  // Decodes the whole execution into 'ex'.
+  void Materialize(SymbolicExecution* ex) const;
+
+  // Appends the execution to 's' as a complete trace, as
+  // SymbolicExecution::Serialize would, and reads such a trace back from
+  // 's' into an (owned) view.
+  void Serialize(string* s) const;
+  bool Parse(istream& s);
+
+ private:
+  const char* data_;
+  size_t size_;
+  bool mapped_;  // If not, data_ is in buf_.
+  vector<char> buf_;
+
+  // The length of the complete records of the trace, up to (and not
+  // including) any kTraceEnd.
+  size_t trace_size_;
+
+  map<var_t,type_t> vars_;
+  vector<value_t> inputs_;
+  vector<branch_id_t> branches_;
+  vector<size_t> constraints_idx_;
+  vector<compare_op_t> ops_;
+  // The offset and length in the trace of each distinct expression, and
+  // the expression of each constraint.
+  vector< pair<size_t,size_t> > exprs_;
+  vector<unsigned int> expr_idx_;
+
+  // The partition of the constraints, extended by DependentConstraints.
+  mutable ConstraintPartition partition_;
+  mutable vector<var_t> tmp_vars_;
+
+  bool Index();
+
+  // Disallow copying.
+  ExecutionView(const ExecutionView&);
+  void operator=(const ExecutionView&);
+};
+
+}  // namespace crest
+
+#endif  // BASE_EXECUTION_VIEW_H__
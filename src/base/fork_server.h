@@ -0,0 +1,37 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_FORK_SERVER_H__
+#define BASE_FORK_SERVER_H__
+
+namespace crest {
+
+// Protocol between run_crest and an instrumented program running as a
+// fork server.
+//
+// When run_crest launches the program with kForkServerEnv set in its
+// environment, __CrestInit does not return.  Instead, it writes a 4-byte
+// hello message to kForkServerStatusFd and then loops:
+//   - read a 4-byte request from kForkServerCtrlFd (exit on EOF),
+//   - fork a child, which returns from __CrestInit and runs the program
+//     on the current "input",
+//   - write the child's pid (4 bytes) to kForkServerStatusFd,
+//   - wait for the child, and write its exit status (4 bytes).
+//
+// Thus, each iteration pays for a fork() instead of for starting a shell,
+// exec'ing the program, and dynamic linking/initialization.
+
+static const char kForkServerEnv[] = "CREST_FORK_SERVER";
+static const int kForkServerCtrlFd = 198;
+static const int kForkServerStatusFd = 199;
+
+}  // namespace crest
+
+#endif  // BASE_FORK_SERVER_H__
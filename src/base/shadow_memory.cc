@@ -0,0 +1,139 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "base/shadow_memory.h"
+
+using std::make_pair;
+
+namespace crest {
+
+typedef map<addr_t,SymbolicExpr*>::const_iterator ConstMemIt;
+
+ShadowMemory::ShadowMemory() : size_(0) {
+  // A large, zero-filled allocation, whose pages the OS only backs once
+  // they are touched.
+  l1_ = static_cast<L2**>(calloc(kL1Size, sizeof(L2*)));
+  if (!l1_) {
+    perror("Error: Failed to allocate shadow memory");
+    exit(-1);
+  }
+}
+
+ShadowMemory::~ShadowMemory() {
+  for (size_t i = 0; i < kL1Size; i++) {
+    if (l1_[i]) {
+      for (size_t j = 0; j < kL2Size; j++)
+        free(l1_[i]->pages[j]);
+      free(l1_[i]);
+    }
+  }
+  free(l1_);
+}
+
+
+SymbolicExpr* ShadowMemory::FindLarge(addr_t addr) const {
+  ConstMemIt it = large_.find(addr);
+  return (it == large_.end()) ? NULL : it->second;
+}
+
+
+SymbolicExpr* ShadowMemory::Set(addr_t addr, SymbolicExpr* expr) {
+  assert(expr);
+  SymbolicExpr* old;
+
+  if (addr >> kAddrBits) {
+    SymbolicExpr*& slot = large_[addr];
+    old = slot;
+    slot = expr;
+  } else {
+    L2*& l2 = l1_[addr >> (kPageBits + kL2Bits)];
+    if (!l2) {
+      l2 = static_cast<L2*>(calloc(1, sizeof(L2)));
+      assert(l2);
+    }
+    Page*& page = l2->pages[(addr >> kPageBits) & (kL2Size - 1)];
+    if (!page) {
+      page = static_cast<Page*>(calloc(1, sizeof(Page)));
+      assert(page);
+    }
+    SymbolicExpr*& slot = page->slots[addr & (kPageSize - 1)];
+    old = slot;
+    slot = expr;
+    if (!old)
+      page->count++;
+  }
+
+  if (!old)
+    size_++;
+  return old;
+}
+
+
+SymbolicExpr* ShadowMemory::Erase(addr_t addr) {
+  if (size_ == 0)
+    return NULL;
+
+  SymbolicExpr* old = NULL;
+  if (addr >> kAddrBits) {
+    map<addr_t,SymbolicExpr*>::iterator it = large_.find(addr);
+    if (it != large_.end()) {
+      old = it->second;
+      large_.erase(it);
+    }
+  } else {
+    L2* l2 = l1_[addr >> (kPageBits + kL2Bits)];
+    if (!l2)
+      return NULL;
+    Page*& page = l2->pages[(addr >> kPageBits) & (kL2Size - 1)];
+    if (!page)
+      return NULL;
+    SymbolicExpr*& slot = page->slots[addr & (kPageSize - 1)];
+    old = slot;
+    slot = NULL;
+    if (old && (--page->count == 0)) {
+      free(page);
+      page = NULL;
+    }
+  }
+
+  if (old)
+    size_--;
+  return old;
+}
+
+
+void ShadowMemory::AppendEntries(
+    vector< pair<addr_t,SymbolicExpr*> >* entries) const {
+  // Stop once all of the pages' entries have been found.
+  const size_t num_entries = entries->size() + size_ - large_.size();
+  for (size_t i = 0; (i < kL1Size) && (entries->size() < num_entries); i++) {
+    if (!l1_[i])
+      continue;
+    for (size_t j = 0; j < kL2Size; j++) {
+      const Page* page = l1_[i]->pages[j];
+      if (!page)
+        continue;
+      for (size_t k = 0; k < kPageSize; k++) {
+        if (page->slots[k]) {
+          addr_t addr = (((addr_t)i << (kPageBits + kL2Bits))
+                         | ((addr_t)j << kPageBits) | k);
+          entries->push_back(make_pair(addr, page->slots[k]));
+        }
+      }
+    }
+  }
+  entries->insert(entries->end(), large_.begin(), large_.end());
+}
+
+}  // namespace crest
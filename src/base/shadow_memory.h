@@ -0,0 +1,101 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_SHADOW_MEMORY_H__
+#define BASE_SHADOW_MEMORY_H__
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_expression.h"
+
+using std::map;
+using std::pair;
+using std::vector;
+
+namespace crest {
+
+// Maps addresses to the symbolic expressions stored at them.
+//
+// Addresses below 2^48 are looked up in a page table: a first-level
+// directory, indexed by the top 20 bits, of second-level directories,
+// indexed by the next 16 bits, of pages of 4096 slots.  Directories and
+// pages are only allocated once something symbolic is stored in them,
+// and a page is freed once it is empty again.  Thus, a load from a
+// concrete location costs a couple of loads and a branch.  (Any other
+// addresses fall back to a map.)
+//
+// The shadow memory does not own the expressions -- Set and Erase return
+// any expression they replace.
+class ShadowMemory {
+ public:
+  ShadowMemory();
+  ~ShadowMemory();
+
+  // Returns the expression stored at 'addr', or NULL if it is concrete.
+  SymbolicExpr* Find(addr_t addr) const {
+    if (size_ == 0)
+      return NULL;
+    if (addr >> kAddrBits)
+      return FindLarge(addr);
+    L2* l2 = l1_[addr >> (kPageBits + kL2Bits)];
+    if (!l2)
+      return NULL;
+    Page* page = l2->pages[(addr >> kPageBits) & (kL2Size - 1)];
+    if (!page)
+      return NULL;
+    return page->slots[addr & (kPageSize - 1)];
+  }
+
+  // Stores 'expr' (non-NULL) at 'addr'.
+  SymbolicExpr* Set(addr_t addr, SymbolicExpr* expr);
+
+  // Makes 'addr' concrete.
+  SymbolicExpr* Erase(addr_t addr);
+
+  // Number of symbolic locations.
+  size_t size() const { return size_; }
+
+  // Appends all (address, expression) pairs, in order of address.
+  void AppendEntries(vector< pair<addr_t,SymbolicExpr*> >* entries) const;
+
+ private:
+  static const int kAddrBits = 48;
+  static const int kPageBits = 12;
+  static const int kL2Bits = 16;
+  static const size_t kPageSize = 1UL << kPageBits;
+  static const size_t kL2Size = 1UL << kL2Bits;
+  static const size_t kL1Size = 1UL << (kAddrBits - kPageBits - kL2Bits);
+
+  struct Page {
+    SymbolicExpr* slots[kPageSize];
+    size_t count;
+  };
+
+  struct L2 {
+    Page* pages[kL2Size];
+  };
+
+  L2** l1_;
+  map<addr_t,SymbolicExpr*> large_;
+  size_t size_;
+
+  SymbolicExpr* FindLarge(addr_t addr) const;
+
+  // Disallow copying.
+  ShadowMemory(const ShadowMemory&);
+  void operator=(const ShadowMemory&);
+};
+
+}  // namespace crest
+
+#endif  // BASE_SHADOW_MEMORY_H__
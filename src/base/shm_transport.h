@@ -0,0 +1,33 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_SHM_TRANSPORT_H__
+#define BASE_SHM_TRANSPORT_H__
+
+namespace crest {
+
+// Shared-memory transport between run_crest and libcrest.
+//
+// Instead of the "input" and "szd_execution" files, run_crest can pass the
+// program under test two anonymous shared-memory files (memfd's), whose
+// descriptor numbers are given in the environment:
+//   - kInputFdEnv: the input, as a raw array of value_t's (the file size
+//     gives the number of inputs), written by run_crest.
+//   - kExecutionFdEnv: the serialized SymbolicExecution, written by
+//     libcrest at exit and parsed by run_crest directly from a mapping
+//     of the file.  run_crest truncates it to zero length before each
+//     run, so an empty file means the program did not exit normally.
+
+static const char kInputFdEnv[] = "CREST_INPUT_FD";
+static const char kExecutionFdEnv[] = "CREST_EXECUTION_FD";
+
+}  // namespace crest
+
+#endif  // BASE_SHM_TRANSPORT_H__
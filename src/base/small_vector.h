@@ -0,0 +1,125 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_SMALL_VECTOR_H__
+#define BASE_SMALL_VECTOR_H__
+
+#include <algorithm>
+#include <stddef.h>
+
+namespace crest {
+
+// A vector which stores up to N elements inline, and only allocates on
+// the heap when it grows beyond that.  Intended for small, plain types
+// (elements are copied with operator=, and never destroyed individually).
+template <typename T, size_t N>
+class SmallVector {
+ public:
+  typedef T value_type;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  SmallVector() : data_(inline_), size_(0), capacity_(N) { }
+
+  SmallVector(const SmallVector& v)
+    : data_(inline_), size_(0), capacity_(N) {
+    *this = v;
+  }
+
+  ~SmallVector() {
+    if (data_ != inline_)
+      delete [] data_;
+  }
+
+  SmallVector& operator=(const SmallVector& v) {
+    if (this != &v) {
+      clear();
+      reserve(v.size_);
+      std::copy(v.begin(), v.end(), data_);
+      size_ = v.size_;
+    }
+    return *this;
+  }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return (size_ == 0); }
+
+  T& operator[](size_t i) { return data_[i]; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  T& back() { return data_[size_ - 1]; }
+  const T& back() const { return data_[size_ - 1]; }
+
+  void clear() { size_ = 0; }
+
+  // New elements (if any) are left unset.
+  void resize(size_t n) {
+    reserve(n);
+    size_ = n;
+  }
+
+  void reserve(size_t n) {
+    if (n <= capacity_)
+      return;
+    T* data = new T[n];
+    std::copy(begin(), end(), data);
+    if (data_ != inline_)
+      delete [] data_;
+    data_ = data;
+    capacity_ = n;
+  }
+
+  void push_back(const T& x) {
+    if (size_ == capacity_)
+      reserve(2 * capacity_);
+    data_[size_++] = x;
+  }
+
+  void swap(SmallVector& v) {
+    if ((data_ != inline_) && (v.data_ != v.inline_)) {
+      std::swap(data_, v.data_);
+      std::swap(size_, v.size_);
+      std::swap(capacity_, v.capacity_);
+    } else if (data_ != inline_) {
+      v.swap(*this);
+    } else if (v.data_ != v.inline_) {
+      // Take v's heap storage, and give v our (inline) elements.
+      std::copy(begin(), end(), v.inline_);
+      data_ = v.data_;
+      v.data_ = v.inline_;
+      std::swap(size_, v.size_);
+      std::swap(capacity_, v.capacity_);
+    } else {
+      // Both are stored inline, so the elements must be copied.
+      SmallVector tmp(*this);
+      *this = v;
+      v = tmp;
+    }
+  }
+
+  bool operator==(const SmallVector& v) const {
+    return ((size_ == v.size_) && std::equal(begin(), end(), v.begin()));
+  }
+
+ private:
+  T* data_;
+  size_t size_;
+  size_t capacity_;
+  T inline_[N];
+};
+
+}  // namespace crest
+
+#endif  // BASE_SMALL_VECTOR_H__
@@ -0,0 +1,242 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <utility>
+
+#include "base/solver_cache.h"
+
+using std::includes;
+using std::make_pair;
+using std::sort;
+using std::unique;
+
+namespace crest {
+
+namespace {
+
+typedef vector<const SymbolicPred*>::const_iterator PredIt;
+
+// Drop the whole cache once it holds this many results.
+const size_t kMaxResults = 1000000;
+
+// Number of solutions kept per constraint for re-use.
+const size_t kMaxSolutionsPerId = 8;
+
+// Evaluates predicate 'p' on the assignment 'vals'.  Gives up (returns
+// false) if the arithmetic might overflow, as the solver reasons about
+// unbounded integers.
+bool IsSatisfied(const SymbolicPred& p, const vector<value_t>& vals) {
+  const SymbolicExpr& e = p.expr();
+  value_t sum = e.const_term();
+  double approx = static_cast<double>(e.const_term());
+  for (SymbolicExpr::TermIt i = e.terms().begin(); i != e.terms().end(); ++i) {
+    if (i->first >= vals.size())
+      return false;
+    // Check the product and the new sum in floating point first, so that
+    // the integer arithmetic below cannot overflow.
+    const double term =
+      static_cast<double>(i->second) * static_cast<double>(vals[i->first]);
+    approx += term;
+    if ((fabs(term) > 4e18) || (fabs(approx) > 4e18))
+      return false;
+    sum += i->second * vals[i->first];
+  }
+
+  switch (p.op()) {
+  case ops::EQ:  return (sum == 0);
+  case ops::NEQ: return (sum != 0);
+  case ops::GT:  return (sum > 0);
+  case ops::LE:  return (sum <= 0);
+  case ops::LT:  return (sum < 0);
+  case ops::GE:  return (sum >= 0);
+  }
+  return false;
+}
+
+// Checks that 'soln', with values missing from it taken from 'old_soln',
+// respects the types of 'vars' and satisfies 'constraints'.  If so, sets
+// *vals to the combined values.
+bool CheckSolution(const vector<value_t>& old_soln,
+                   const map<var_t,type_t>& vars,
+                   const vector<const SymbolicPred*>& constraints,
+                   const map<var_t,value_t>& soln,
+                   vector<value_t>* vals) {
+  *vals = old_soln;
+  typedef map<var_t,value_t>::const_iterator SolnIt;
+  for (SolnIt j = soln.begin(); j != soln.end(); ++j) {
+    if (j->first < vals->size())
+      (*vals)[j->first] = j->second;
+  }
+
+  typedef map<var_t,type_t>::const_iterator VarIt;
+  for (VarIt j = vars.begin(); j != vars.end(); ++j) {
+    if ((j->second < types::U_LONG) &&
+        ((j->first >= vals->size())
+         || ((*vals)[j->first] < kMinValue[j->second])
+         || ((*vals)[j->first] > kMaxValue[j->second])))
+      return false;
+  }
+  for (PredIt j = constraints.begin(); j != constraints.end(); ++j) {
+    if (!IsSatisfied(**j, *vals))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+
+SolverCache::SolverCache()
+  : num_lookups_(0), num_exact_hits_(0),
+    num_unsat_subset_hits_(0), num_solution_hits_(0), time_saved_(0) { }
+
+SolverCache::~SolverCache() { }
+
+
+void SolverCache::Clear() {
+  ids_.clear();
+  results_.clear();
+  unsat_by_min_id_.clear();
+  sat_by_id_.clear();
+}
+
+
+unsigned int SolverCache::Intern(const map<var_t,type_t>& vars,
+                                 const SymbolicPred& p) {
+  string s;
+  p.Serialize(&s);
+  // The terms are sorted by variable, so the types follow in a fixed order.
+  for (SymbolicExpr::TermIt i = p.expr().terms().begin();
+       i != p.expr().terms().end(); ++i) {
+    map<var_t,type_t>::const_iterator v = vars.find(i->first);
+    s.push_back(static_cast<char>((v == vars.end()) ? -1 : v->second));
+  }
+  return ids_.insert(make_pair(s, ids_.size())).first->second;
+}
+
+
+void SolverCache::MakeKey(const map<var_t,type_t>& vars,
+                          const vector<const SymbolicPred*>& constraints,
+                          Key* key) {
+  key->clear();
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    key->push_back(Intern(vars, **i));
+  }
+  sort(key->begin(), key->end());
+  key->erase(unique(key->begin(), key->end()), key->end());
+}
+
+
+bool SolverCache::Lookup(const vector<value_t>& old_soln,
+                         const map<var_t,type_t>& vars,
+                         const vector<const SymbolicPred*>& constraints,
+                         bool* sat, map<var_t,value_t>* soln) {
+  num_lookups_ ++;
+
+  Key key;
+  MakeKey(vars, constraints, &key);
+  vector<value_t> vals;
+
+  // (1) Exact match.  (A cached solution is checked, as for (3).)
+  hash_map<Key,Entry,KeyHash>::const_iterator it = results_.find(key);
+  if ((it != results_.end())
+      && (!it->second.sat
+          || CheckSolution(old_soln, vars, constraints, it->second.soln, &vals))) {
+    num_exact_hits_ ++;
+    time_saved_ += it->second.secs;
+    *sat = it->second.sat;
+    *soln = it->second.soln;
+    return true;
+  }
+
+  // (2) Some subset of the constraints is known to be UNSAT.
+  for (Key::const_iterator i = key.begin(); i != key.end(); ++i) {
+    map< unsigned int, vector<Key> >::const_iterator u = unsat_by_min_id_.find(*i);
+    if (u == unsat_by_min_id_.end())
+      continue;
+    for (vector<Key>::const_iterator j = u->second.begin(); j != u->second.end(); ++j) {
+      if (includes(key.begin(), key.end(), j->begin(), j->end())) {
+        num_unsat_subset_hits_ ++;
+        time_saved_ += results_.find(*j)->second.secs;
+        *sat = false;
+        return true;
+      }
+    }
+  }
+
+  // (3) A solution to an earlier query involving the last constraint
+  // happens to satisfy all of the constraints.
+  map< unsigned int, vector<const Entry*> >::const_iterator s =
+    sat_by_id_.find(Intern(vars, *constraints.back()));
+  if (s == sat_by_id_.end())
+    return false;
+
+  for (vector<const Entry*>::const_iterator i = s->second.begin();
+       i != s->second.end(); ++i) {
+    if (CheckSolution(old_soln, vars, constraints, (*i)->soln, &vals)) {
+      num_solution_hits_ ++;
+      time_saved_ += (*i)->secs;
+      *sat = true;
+      soln->clear();
+      typedef map<var_t,type_t>::const_iterator VarIt;
+      for (VarIt j = vars.begin(); j != vars.end(); ++j) {
+        soln->insert(make_pair(j->first, vals[j->first]));
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+void SolverCache::Insert(const map<var_t,type_t>& vars,
+                         const vector<const SymbolicPred*>& constraints,
+                         bool sat, const map<var_t,value_t>& soln,
+                         double secs) {
+  if (results_.size() >= kMaxResults) {
+    Clear();
+  }
+
+  Key key;
+  MakeKey(vars, constraints, &key);
+  if (key.empty())
+    return;
+
+  Entry& e = results_[key];
+  e.sat = sat;
+  e.soln = soln;
+  e.secs = secs;
+
+  if (!sat) {
+    unsat_by_min_id_[key.front()].push_back(key);
+  } else {
+    for (Key::const_iterator i = key.begin(); i != key.end(); ++i) {
+      vector<const Entry*>& sols = sat_by_id_[*i];
+      if (sols.size() >= kMaxSolutionsPerId)
+        sols.erase(sols.begin());
+      sols.push_back(&e);
+    }
+  }
+}
+
+
+void SolverCache::PrintStats() const {
+  fprintf(stderr, "Solver cache: %u lookups, %u exact hits, "
+          "%u unsat-subset hits, %u solution hits, %u misses "
+          "(saving %.1fs of solver time)\n",
+          num_lookups_, num_exact_hits_, num_unsat_subset_hits_,
+          num_solution_hits_, num_misses(), time_saved_);
+}
+
+}  // namespace crest
@@ -0,0 +1,121 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_SOLVER_CACHE_H__
+#define BASE_SOLVER_CACHE_H__
+
+#include <ext/hash_map>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_predicate.h"
+
+using std::map;
+using std::string;
+using std::vector;
+using __gnu_cxx::hash_map;
+
+namespace crest {
+
+// A cache of solver results, keyed by (canonicalized) sets of constraints.
+//
+// Each distinct constraint (together with the types of its variables,
+// which bound their values) is interned to an integer ID, and a set of
+// constraints is represented by its sorted, de-duplicated list of IDs.
+// A query is answered, in order, by:
+//  (1) an exact match -- the cached SAT solution, or UNSAT,
+//  (2) a cached UNSAT set which is a subset of the query -- UNSAT,
+//  (3) a cached solution (for a set containing the query's last
+//      constraint) which also satisfies every constraint in the query.
+// (This is the counterexample cache of KLEE, without the UBTree.)
+class SolverCache {
+ public:
+  SolverCache();
+  ~SolverCache();
+
+  // Tries to answer a query for 'constraints', where 'vars' are the
+  // variables appearing in them (with their types, which are part of the
+  // key).  On success, returns true and sets *sat (and, if SAT, *soln to
+  // values for all of 'vars').  Values of variables missing from a reused
+  // solution are taken from 'old_soln'.  A cached solution is only
+  // returned if it is checked to satisfy the constraints and the types.
+  bool Lookup(const vector<value_t>& old_soln,
+              const map<var_t,type_t>& vars,
+              const vector<const SymbolicPred*>& constraints,
+              bool* sat, map<var_t,value_t>* soln);
+
+  // Records the solver's answer for 'constraints', which took the solver
+  // 'secs' seconds.
+  void Insert(const map<var_t,type_t>& vars,
+              const vector<const SymbolicPred*>& constraints,
+              bool sat, const map<var_t,value_t>& soln, double secs);
+
+  unsigned int num_lookups() const { return num_lookups_; }
+  unsigned int num_exact_hits() const { return num_exact_hits_; }
+  unsigned int num_unsat_subset_hits() const { return num_unsat_subset_hits_; }
+  unsigned int num_solution_hits() const { return num_solution_hits_; }
+  unsigned int num_misses() const {
+    return (num_lookups_ - num_exact_hits_
+            - num_unsat_subset_hits_ - num_solution_hits_);
+  }
+
+  // The solver time saved by hits, estimated by the time taken by the
+  // cached queries which answered them.
+  double time_saved() const { return time_saved_; }
+
+  void PrintStats() const;
+
+ private:
+  typedef vector<unsigned int> Key;
+
+  struct KeyHash {
+    size_t operator()(const Key& k) const {
+      size_t h = 0;
+      for (Key::const_iterator i = k.begin(); i != k.end(); ++i)
+        h = (h * 31) + *i;
+      return h;
+    }
+  };
+
+  struct Entry {
+    bool sat;
+    map<var_t,value_t> soln;
+    double secs;
+  };
+
+  // Interned constraints, together with the types of their variables.
+  map<string,unsigned int> ids_;
+
+  // Exact results.
+  hash_map<Key,Entry,KeyHash> results_;
+
+  // All UNSAT sets, indexed by their smallest constraint ID.
+  map< unsigned int, vector<Key> > unsat_by_min_id_;
+
+  // The most recent SAT solutions, indexed by constraint ID.
+  map< unsigned int, vector<const Entry*> > sat_by_id_;
+
+  unsigned int num_lookups_;
+  unsigned int num_exact_hits_;
+  unsigned int num_unsat_subset_hits_;
+  unsigned int num_solution_hits_;
+  double time_saved_;
+
+  unsigned int Intern(const map<var_t,type_t>& vars, const SymbolicPred& p);
+  void MakeKey(const map<var_t,type_t>& vars,
+               const vector<const SymbolicPred*>& constraints, Key* key);
+  void Clear();
+};
+
+}  // namespace crest
+
+#endif  // BASE_SOLVER_CACHE_H__
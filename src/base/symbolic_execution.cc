@@ -10,6 +10,7 @@
 
 #include <utility>
 
+#include "base/execution_trace.h"
 #include "base/symbolic_execution.h"
 
 namespace crest {
@@ -28,33 +29,19 @@ void SymbolicExecution::Swap(SymbolicExecution& se) {
 }
 
 void SymbolicExecution::Serialize(string* s) const {
-  typedef map<var_t,type_t>::const_iterator VarIt;
-
-  // Write the inputs.
-  size_t len = vars_.size();
-  s->append((char*)&len, sizeof(len));
-  for (VarIt i = vars_.begin(); i != vars_.end(); ++i) {
-    s->push_back(static_cast<char>(i->second));
-    s->append((char*)&inputs_[i->first], sizeof(value_t));
-  }
-
-  // Write the path.
-  path_.Serialize(s);
+  TraceWriter writer;
+  writer.Append(*this, s);
+  writer.Finish(s);
 }
 
 bool SymbolicExecution::Parse(istream& s) {
-  // Read the inputs.
-  size_t len;
-  s.read((char*)&len, sizeof(len));
   vars_.clear();
-  inputs_.resize(len);
-  for (size_t i = 0; i < len; i++) {
-    vars_[i] = static_cast<type_t>(s.get());
-    s.read((char*)&inputs_[i], sizeof(value_t));
-  }
-
-  // Write the path.
-  return (path_.Parse(s) && !s.fail());
+  inputs_.clear();
+  SymbolicPath empty;
+  path_.Swap(empty);
+
+  // (A truncated trace leaves 's' at its end.)
+  return ReadTrace(s, this);
 }
 
 }  // namespace crest
@@ -34,6 +34,8 @@ class SymbolicExecution {
 
   void Swap(SymbolicExecution& se);
 
+  // Writes/reads the execution in the trace format (see
+  // base/execution_trace.h).
   void Serialize(string* s) const;
   bool Parse(istream& s);
 
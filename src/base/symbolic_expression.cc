@@ -10,12 +10,36 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include "base/arena.h"
 #include "base/symbolic_expression.h"
+#include "base/varint.h"
+
+using std::make_pair;
 
 namespace crest {
 
-typedef map<var_t,value_t>::iterator It;
-typedef map<var_t,value_t>::const_iterator ConstIt;
+typedef SymbolicExpr::Terms::iterator It;
+typedef SymbolicExpr::Terms::const_iterator ConstIt;
+
+namespace {
+// Never deleted -- its memory is released in one shot at exit.
+FixedArena* arena = NULL;
+}  // namespace
+
+
+void* SymbolicExpr::operator new(size_t size) {
+  assert(size == sizeof(SymbolicExpr));
+  if (!arena) {
+    arena = new FixedArena(sizeof(SymbolicExpr));
+  }
+  return arena->Allocate();
+}
+
+void SymbolicExpr::operator delete(void* p) {
+  if (p)
+    arena->Free(p);
+}
+
 
 
 SymbolicExpr::~SymbolicExpr() { }
@@ -25,7 +49,7 @@ SymbolicExpr::SymbolicExpr() : const_(0) { }
 SymbolicExpr::SymbolicExpr(value_t c) : const_(c) { }
 
 SymbolicExpr::SymbolicExpr(value_t c, var_t v) : const_(0) {
-  coeff_[v] = c;
+  coeff_.push_back(make_pair(v, c));
 }
 
 SymbolicExpr::SymbolicExpr(const SymbolicExpr& e)
@@ -70,66 +94,159 @@ void SymbolicExpr::AppendToString(string* s) const {
 
 
 void SymbolicExpr::Serialize(string* s) const {
-  assert(coeff_.size() < 128);
-  s->push_back(static_cast<char>(coeff_.size()));
-  s->append((char*)&const_, sizeof(value_t));
+  // The terms are sorted, so the variables are delta-coded.
+  AppendVarint(s, coeff_.size());
+  AppendVarint(s, ZigZag(const_));
+  var_t last = 0;
   for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
-    s->append((char*)&i->first, sizeof(var_t));
-    s->append((char*)&i->second, sizeof(value_t));
+    AppendVarint(s, i->first - last);
+    AppendVarint(s, ZigZag(i->second));
+    last = i->first;
   }
 }
 
 
 bool SymbolicExpr::Parse(istream& s) {
-  size_t len = static_cast<size_t>(s.get());
-  s.read((char*)&const_, sizeof(value_t));
-  if (s.fail())
+  unsigned long long len, x;
+  if (!ReadVarint(s, &len) || !ReadVarint(s, &x))
     return false;
+  const_ = UnZigZag(x);
 
   coeff_.clear();
+  var_t v = 0;
   for (size_t i = 0; i < len; i++) {
-    var_t v;
-    value_t c;
-    s.read((char*)&v, sizeof(v));
-    s.read((char*)&c, sizeof(c));
-    coeff_[v] = c;
+    unsigned long long dv, c;
+    if (!ReadVarint(s, &dv) || !ReadVarint(s, &c))
+      return false;
+    v += dv;
+    coeff_.push_back(make_pair(v, UnZigZag(c)));
   }
 
   return !s.fail();
 }
 
 
+bool SymbolicExpr::Parse(const char** p, const char* end) {
+  unsigned long long len, x;
+  if (!DecodeVarint(p, end, &len) || !DecodeVarint(p, end, &x))
+    return false;
+  const_ = UnZigZag(x);
+
+  coeff_.clear();
+  var_t v = 0;
+  for (size_t i = 0; i < len; i++) {
+    unsigned long long dv, c;
+    if (!DecodeVarint(p, end, &dv) || !DecodeVarint(p, end, &c))
+      return false;
+    v += dv;
+    coeff_.push_back(make_pair(v, UnZigZag(c)));
+  }
+
+  return true;
+}
+
+
 const SymbolicExpr& SymbolicExpr::operator+=(const SymbolicExpr& e) {
   const_ += e.const_;
-  for (ConstIt i = e.coeff_.begin(); i != e.coeff_.end(); ++i) {
-    It j = coeff_.find(i->first);
-    if (j == coeff_.end()) {
-      coeff_.insert(*i);
-    } else {
-      j->second += i->second;
-      if (j->second == 0) {
-	coeff_.erase(j);
-      }
-    }
-  }
+  AddTerms(e, 1);
   return *this;
 }
 
 
 const SymbolicExpr& SymbolicExpr::operator-=(const SymbolicExpr& e) {
   const_ -= e.const_;
-  for (ConstIt i = e.coeff_.begin(); i != e.coeff_.end(); ++i) {
-    It j = coeff_.find(i->first);
-    if (j == coeff_.end()) {
-      coeff_[i->first] = -i->second;
+  AddTerms(e, -1);
+  return *this;
+}
+
+
+void SymbolicExpr::AddTerms(const SymbolicExpr& e, value_t sign) {
+  if (e.coeff_.empty())
+    return;
+  if (&e == this) {
+    SymbolicExpr copy(e);
+    AddTerms(copy, sign);
+    return;
+  }
+
+  // Count the distinct variables, and the terms left once those that
+  // cancel are dropped, so that the terms grow only if they have to.
+  size_t num_vars = coeff_.size() + e.coeff_.size();
+  size_t num_terms = num_vars;
+  {
+    ConstIt i = coeff_.begin();
+    ConstIt j = e.coeff_.begin();
+    while ((i != coeff_.end()) && (j != e.coeff_.end())) {
+      if (i->first < j->first) {
+        ++i;
+      } else if (j->first < i->first) {
+        ++j;
+      } else {
+        num_vars--;
+        num_terms -= ((i->second + sign * j->second) == 0) ? 2 : 1;
+        ++i;
+        ++j;
+      }
+    }
+  }
+
+  if (num_vars > coeff_.capacity()) {
+    // Merge into new terms (stored inline, if they fit).
+    Terms sum;
+    sum.reserve(num_terms);
+    ConstIt i = coeff_.begin();
+    ConstIt j = e.coeff_.begin();
+    while ((i != coeff_.end()) || (j != e.coeff_.end())) {
+      if ((j == e.coeff_.end())
+          || ((i != coeff_.end()) && (i->first < j->first))) {
+        sum.push_back(*i++);
+      } else if ((i == coeff_.end()) || (j->first < i->first)) {
+        sum.push_back(make_pair(j->first, sign * j->second));
+        ++j;
+      } else {
+        value_t c = i->second + sign * j->second;
+        if (c != 0) {
+          sum.push_back(make_pair(i->first, c));
+        }
+        ++i;
+        ++j;
+      }
+    }
+    coeff_.swap(sum);
+    return;
+  }
+
+  // Merge in place, from the back (so that no term is overwritten before
+  // it is read), keeping any terms that cancel for now.  Once e's terms
+  // run out, the rest of ours are already in place.
+  const size_t old_size = coeff_.size();
+  coeff_.resize(num_vars);
+  It out = coeff_.end();
+  It i = coeff_.begin() + old_size;
+  ConstIt j = e.coeff_.end();
+  while (j != e.coeff_.begin()) {
+    if ((i != coeff_.begin()) && ((i-1)->first > (j-1)->first)) {
+      *--out = *--i;
+    } else if ((i != coeff_.begin()) && ((i-1)->first == (j-1)->first)) {
+      --i;
+      --j;
+      *--out = make_pair(i->first, i->second + sign * j->second);
     } else {
-      j->second -= i->second;
-      if (j->second == 0) {
-	coeff_.erase(j);
+      --j;
+      *--out = make_pair(j->first, sign * j->second);
+    }
+  }
+
+  // Drop the terms that cancelled.
+  if (num_terms < num_vars) {
+    It k = coeff_.begin();
+    for (ConstIt t = coeff_.begin(); t != coeff_.end(); ++t) {
+      if (t->second != 0) {
+        *k++ = *t;
       }
     }
+    coeff_.resize(num_terms);
   }
-  return *this;
 }
 
 
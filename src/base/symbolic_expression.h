@@ -16,12 +16,15 @@
 #include <ostream>
 #include <set>
 #include <string>
+#include <utility>
 
 #include "base/basic_types.h"
+#include "base/small_vector.h"
 
 using std::istream;
 using std::map;
 using std::ostream;
+using std::pair;
 using std::set;
 using std::string;
 
@@ -44,6 +47,10 @@ class SymbolicExpr {
   // Desctructor.
   ~SymbolicExpr();
 
+  // Expressions are allocated from a FixedArena (see base/arena.h).
+  static void* operator new(size_t size);
+  static void operator delete(void* p);
+
   void Negate();
   bool IsConcrete() const { return coeff_.empty(); }
   size_t Size() const { return (1 + coeff_.size()); }
@@ -54,6 +61,8 @@ class SymbolicExpr {
 
   void Serialize(string* s) const;
   bool Parse(istream& s);
+  // As Parse, but from the bytes [*p, end), advancing *p.
+  bool Parse(const char** p, const char* end);
 
   // Arithmetic operators.
   const SymbolicExpr& operator+=(const SymbolicExpr& e);
@@ -63,14 +72,21 @@ class SymbolicExpr {
   const SymbolicExpr& operator*=(value_t c);
   bool operator==(const SymbolicExpr& e) const;
 
+  // The (variable, coefficient) terms, sorted by variable.  Most
+  // expressions have only a few terms, which are stored inline.
+  typedef SmallVector<pair<var_t,value_t>,4> Terms;
+  typedef Terms::const_iterator TermIt;
+
   // Accessors.
   value_t const_term() const { return const_; }
-  const map<var_t,value_t>& terms() const { return coeff_; }
-  typedef map<var_t,value_t>::const_iterator TermIt;
+  const Terms& terms() const { return coeff_; }
 
  private:
   value_t const_;
-  map<var_t,value_t> coeff_;
+  Terms coeff_;
+
+  // Adds 'sign' * 'e' to the terms.
+  void AddTerms(const SymbolicExpr& e, value_t sign);
 };
 
 }  // namespace crest
@@ -29,7 +29,7 @@ using std::vector;
 
 namespace crest {
 
-typedef map<addr_t,SymbolicExpr*>::const_iterator ConstMemIt;
+typedef vector< pair<addr_t,SymbolicExpr*> >::const_iterator ConstMemIt;
 
 SymbolicInterpreter::SymbolicInterpreter()
   : pred_(NULL), return_value_(false), ex_(true), num_inputs_(0) {
@@ -43,7 +43,9 @@ SymbolicInterpreter::SymbolicInterpreter(const vector<value_t>& input)
 }
 
 void SymbolicInterpreter::DumpMemory() {
-  for (ConstMemIt i = mem_.begin(); i != mem_.end(); ++i) {
+  vector< pair<addr_t,SymbolicExpr*> > mem;
+  mem_.AppendEntries(&mem);
+  for (ConstMemIt i = mem.begin(); i != mem.end(); ++i) {
     string s;
     i->second->AppendToString(&s);
     fprintf(stderr, "%lu: %s [%d]\n", i->first, s.c_str(), *(int*)(i->first));
@@ -82,11 +84,11 @@ void SymbolicInterpreter::ClearStack(id_t id) {
 
 void SymbolicInterpreter::Load(id_t id, addr_t addr, value_t value) {
   IFDEBUG(fprintf(stderr, "load %lu %lld\n", addr, value));
-  ConstMemIt it = mem_.find(addr);
-  if (it == mem_.end()) {
+  SymbolicExpr* expr = mem_.Find(addr);
+  if (expr == NULL) {
     PushConcrete(value);
   } else {
-    PushSymbolic(new SymbolicExpr(*it->second), value);
+    PushSymbolic(new SymbolicExpr(*expr), value);
   }
   ClearPredicateRegister();
   IFDEBUG(DumpMemory());
@@ -100,13 +102,13 @@ void SymbolicInterpreter::Store(id_t id, addr_t addr) {
   const StackElem& se = stack_.back();
   if (se.expr) {
     if (!se.expr->IsConcrete()) {
-      mem_[addr] = se.expr;
+      delete mem_.Set(addr, se.expr);
     } else {
-      mem_.erase(addr);
+      delete mem_.Erase(addr);
       delete se.expr;
     }
   } else {
-    mem_.erase(addr);
+    delete mem_.Erase(addr);
   }
 
   stack_.pop_back();
@@ -310,7 +312,7 @@ void SymbolicInterpreter::Branch(id_t id, branch_id_t bid, bool pred_value) {
 value_t SymbolicInterpreter::NewInput(type_t type, addr_t addr) {
   IFDEBUG(fprintf(stderr, "symbolic_input %d %lu\n", type, addr));
 
-  mem_[addr] = new SymbolicExpr(1, num_inputs_);
+  delete mem_.Set(addr, new SymbolicExpr(1, num_inputs_));
   ex_.mutable_vars()->insert(make_pair(num_inputs_ ,type));
 
   value_t ret = 0;
@@ -18,6 +18,7 @@
 #include <vector>
 
 #include "base/basic_types.h"
+#include "base/shadow_memory.h"
 #include "base/symbolic_execution.h"
 #include "base/symbolic_expression.h"
 #include "base/symbolic_path.h"
@@ -73,7 +74,7 @@ class SymbolicInterpreter {
   bool return_value_;
 
   // Memory map.
-  map<addr_t,SymbolicExpr*> mem_;
+  ShadowMemory mem_;
 
   // The symbolic execution (program path and inputs).
   SymbolicExecution ex_;
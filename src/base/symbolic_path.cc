@@ -32,6 +32,7 @@ void SymbolicPath::Swap(SymbolicPath& sp) {
   branches_.swap(sp.branches_);
   constraints_idx_.swap(sp.constraints_idx_);
   constraints_.swap(sp.constraints_);
+  partition_.Swap(sp.partition_);
 }
 
 void SymbolicPath::Push(branch_id_t bid) {
@@ -46,50 +47,22 @@ void SymbolicPath::Push(branch_id_t bid, SymbolicPred* constraint) {
   branches_.push_back(bid);
 }
 
-void SymbolicPath::Serialize(string* s) const {
-  typedef vector<SymbolicPred*>::const_iterator ConIt;
-
-  // Write the path.
-  size_t len = branches_.size();
-  s->append((char*)&len, sizeof(len));
-  s->append((char*)&branches_.front(), branches_.size() * sizeof(branch_id_t));
-
-  // Write the path constraints.
-  len = constraints_.size();
-  s->append((char*)&len, sizeof(len));
-  s->append((char*)&constraints_idx_.front(), constraints_.size() * sizeof(size_t));
-  for (ConIt i = constraints_.begin(); i != constraints_.end(); ++i) {
-    (*i)->Serialize(s);
-  }
+void SymbolicPath::DependentConstraints(size_t idx,
+                                        vector<size_t>* slice) const {
+  UpdatePartition();
+  partition_.DependentConstraints(idx, slice);
 }
 
-bool SymbolicPath::Parse(istream& s) {
-  typedef vector<SymbolicPred*>::iterator ConIt;
-  size_t len;
-
-  // Read the path.
-  s.read((char*)&len, sizeof(size_t));
-  branches_.resize(len);
-  s.read((char*)&branches_.front(), len * sizeof(branch_id_t));
-  if (s.fail())
-    return false;
-
-  // Clean up any existing path constraints.
-  for (size_t i = 0; i < constraints_.size(); i++)
-    delete constraints_[i];
-
-  // Read the path constraints.
-  s.read((char*)&len, sizeof(size_t));
-  constraints_idx_.resize(len);
-  constraints_.resize(len);
-  s.read((char*)&constraints_idx_.front(), len * sizeof(size_t));
-  for (ConIt i = constraints_.begin(); i != constraints_.end(); ++i) {
-    *i = new SymbolicPred();
-    if (!(*i)->Parse(s))
-      return false;
+void SymbolicPath::UpdatePartition() const {
+  vector<var_t> vars;
+  for (size_t idx = partition_.size(); idx < constraints_.size(); idx++) {
+    const SymbolicExpr& e = constraints_[idx]->expr();
+    vars.clear();
+    for (SymbolicExpr::TermIt i = e.terms().begin(); i != e.terms().end(); ++i) {
+      vars.push_back(i->first);
+    }
+    partition_.Add(vars);
   }
-
-  return !s.fail();
 }
 
 }  // namespace crest
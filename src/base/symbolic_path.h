@@ -17,6 +17,7 @@
 #include <vector>
 
 #include "base/basic_types.h"
+#include "base/constraint_partition.h"
 #include "base/symbolic_predicate.h"
 
 using std::istream;
@@ -36,17 +37,27 @@ class SymbolicPath {
 
   void Push(branch_id_t bid);
   void Push(branch_id_t bid, SymbolicPred* constraint);
-  void Serialize(string* s) const;
-  bool Parse(istream& s);
 
   const vector<branch_id_t>& branches() const { return branches_; }
   const vector<SymbolicPred*>& constraints() const { return constraints_; }
   const vector<size_t>& constraints_idx() const { return constraints_idx_; }
 
+  // Sets *slice to the (sorted) indices of the constraints among the
+  // first idx+1 on which constraint idx depends -- i.e. those connected
+  // to it through shared variables.  Takes time roughly proportional to
+  // the size of constraint idx's partition, rather than to idx.
+  void DependentConstraints(size_t idx, vector<size_t>* slice) const;
+
  private:
   vector<branch_id_t> branches_;
   vector<size_t> constraints_idx_;
   vector<SymbolicPred*> constraints_;
+
+  // The partition of the constraints, extended lazily (by
+  // UpdatePartition) to cover every constraint.
+  mutable ConstraintPartition partition_;
+
+  void UpdatePartition() const;
 };
 
 }  // namespace crest
@@ -8,10 +8,31 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <assert.h>
+
+#include "base/arena.h"
 #include "base/symbolic_predicate.h"
 
 namespace crest {
 
+namespace {
+// Never deleted -- its memory is released in one shot at exit.
+FixedArena* arena = NULL;
+}  // namespace
+
+void* SymbolicPred::operator new(size_t size) {
+  assert(size == sizeof(SymbolicPred));
+  if (!arena) {
+    arena = new FixedArena(sizeof(SymbolicPred));
+  }
+  return arena->Allocate();
+}
+
+void SymbolicPred::operator delete(void* p) {
+  if (p)
+    arena->Free(p);
+}
+
 SymbolicPred::SymbolicPred()
   : op_(ops::EQ), expr_(new SymbolicExpr(0)) { }
 
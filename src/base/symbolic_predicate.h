@@ -31,6 +31,10 @@ class SymbolicPred {
   SymbolicPred(compare_op_t op, SymbolicExpr* expr);
   ~SymbolicPred();
 
+  // Predicates are allocated from a FixedArena (see base/arena.h).
+  static void* operator new(size_t size);
+  static void operator delete(void* p);
+
   void Negate();
   void AppendToString(string* s) const;
 
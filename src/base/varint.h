@@ -0,0 +1,75 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef BASE_VARINT_H__
+#define BASE_VARINT_H__
+
+#include <istream>
+#include <stdio.h>
+#include <string>
+
+using std::istream;
+using std::string;
+
+namespace crest {
+
+// LEB128 variable-length integers: seven bits per byte, least
+// significant first, with the high bit set on every byte but the last.
+inline void AppendVarint(string* s, unsigned long long x) {
+  while (x >= 0x80) {
+    s->push_back(static_cast<char>(x | 0x80));
+    x >>= 7;
+  }
+  s->push_back(static_cast<char>(x));
+}
+
+inline bool ReadVarint(istream& s, unsigned long long* x) {
+  *x = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = s.get();
+    if (c == EOF)
+      return false;
+    *x |= static_cast<unsigned long long>(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return true;
+  }
+  return false;
+}
+
+// As ReadVarint, but decoding from the bytes [*p, end) and advancing *p
+// past the varint.
+inline bool DecodeVarint(const char** p, const char* end,
+                         unsigned long long* x) {
+  *x = 0;
+  for (int shift = 0; (shift < 64) && (*p < end); shift += 7) {
+    unsigned char c = static_cast<unsigned char>(*(*p)++);
+    *x |= static_cast<unsigned long long>(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return true;
+  }
+  return false;
+}
+
+// ZigZag mapping of signed to unsigned integers (0, -1, 1, -2, ... to
+// 0, 1, 2, 3, ...), so that small negative numbers also have short
+// varint encodings.
+inline unsigned long long ZigZag(long long x) {
+  return ((static_cast<unsigned long long>(x) << 1)
+          ^ static_cast<unsigned long long>(x >> 63));
+}
+
+inline long long UnZigZag(unsigned long long x) {
+  return static_cast<long long>((x >> 1) ^ (~(x & 1) + 1));
+}
+
+}  // namespace crest
+
+#endif  // BASE_VARINT_H__
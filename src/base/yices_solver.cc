@@ -9,16 +9,25 @@
 // for details.
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <queue>
 #include <set>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <utility>
 #include <yices_c.h>
 
 #include "base/yices_solver.h"
 
 using std::make_pair;
+using std::pair;
 using std::queue;
 using std::set;
 
@@ -27,10 +36,17 @@ namespace crest {
 typedef vector<const SymbolicPred*>::const_iterator PredIt;
 
 
-bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
-				   const map<var_t,type_t>& vars,
-				   const vector<const SymbolicPred*>& constraints,
-				   map<var_t,value_t>* soln) {
+namespace {
+
+// See YicesSolver::set_query_timeout.
+double query_timeout = 0;
+unsigned int num_timed_out_queries = 0;
+
+// Computes the set of variables on which the last constraint depends,
+// directly or transitively through the other constraints.
+void CollectDependentVars(const map<var_t,type_t>& vars,
+                          const vector<const SymbolicPred*>& constraints,
+                          map<var_t,type_t>* dependent_vars) {
   set<var_t> tmp;
   typedef set<var_t>::const_iterator VarIt;
 
@@ -48,12 +64,11 @@ bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
   // Initialize the set of dependent variables to those in the constraints.
   // (Assumption: Last element of constraints is the only new constraint.)
   // Also, initialize the queue for the BFS.
-  map<var_t,type_t> dependent_vars;
   queue<var_t> Q;
   tmp.clear();
   constraints.back()->AppendVars(&tmp);
   for (VarIt j = tmp.begin(); j != tmp.end(); ++j) {
-    dependent_vars.insert(*vars.find(*j));
+    dependent_vars->insert(*vars.find(*j));
     Q.push(*j);
   }
 
@@ -62,38 +77,290 @@ bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
     var_t i = Q.front();
     Q.pop();
     for (VarIt j = depends[i].begin(); j != depends[i].end(); ++j) {
-      if (dependent_vars.find(*j) == dependent_vars.end()) {
+      if (dependent_vars->find(*j) == dependent_vars->end()) {
 	Q.push(*j);
-	dependent_vars.insert(*vars.find(*j));
+	dependent_vars->insert(*vars.find(*j));
       }
     }
   }
+}
 
-  // Generate the list of dependent constraints.
-  vector<const SymbolicPred*> dependent_constraints;
+// Collects the constraints on which the last constraint depends (including
+// itself), in their original order.
+void SliceConstraints(const map<var_t,type_t>& vars,
+                      const vector<const SymbolicPred*>& constraints,
+                      vector<const SymbolicPred*>* dependent_constraints) {
+  map<var_t,type_t> dependent_vars;
+  CollectDependentVars(vars, constraints, &dependent_vars);
   for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
     if ((*i)->DependsOn(dependent_vars))
-      dependent_constraints.push_back(*i);
+      dependent_constraints->push_back(*i);
   }
+}
 
-  soln->clear();
-  if (Solve(dependent_vars, dependent_constraints, soln)) {
-    // Merge in the constrained variables.
-    for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
-      (*i)->AppendVars(&tmp);
+// Collects the variables (with their types) appearing in the constraints.
+void CollectVars(const map<var_t,type_t>& vars,
+                 const vector<const SymbolicPred*>& constraints,
+                 map<var_t,type_t>* out) {
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    const SymbolicExpr& e = (*i)->expr();
+    for (SymbolicExpr::TermIt j = e.terms().begin(); j != e.terms().end(); ++j) {
+      out->insert(*vars.find(j->first));
     }
-    for (set<var_t>::const_iterator i = tmp.begin(); i != tmp.end(); ++i) {
-      if (soln->find(*i) == soln->end()) {
-	soln->insert(make_pair(*i, old_soln[*i]));
-      }
+  }
+}
+
+// Fills in the old values of all constrained variables not in 'soln'.
+void MergeOldSolution(const vector<value_t>& old_soln,
+                      const vector<const SymbolicPred*>& constraints,
+                      map<var_t,value_t>* soln) {
+  set<var_t> tmp;
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    (*i)->AppendVars(&tmp);
+  }
+  for (set<var_t>::const_iterator i = tmp.begin(); i != tmp.end(); ++i) {
+    if (soln->find(*i) == soln->end()) {
+      soln->insert(make_pair(*i, old_soln[*i]));
     }
-    return true;
   }
+}
+
+// Builds the Yices expression for predicate 'p'.
+yices_expr MakeYicesPred(yices_context ctx,
+                         map<var_t,yices_expr>& x_expr,
+                         yices_expr zero,
+                         const SymbolicPred& p) {
+  const SymbolicExpr& se = p.expr();
+  vector<yices_expr> terms;
+  terms.push_back(yices_mk_num(ctx, se.const_term()));
+  for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
+    yices_expr prod[2] = { x_expr[j->first], yices_mk_num(ctx, j->second) };
+    terms.push_back(yices_mk_mul(ctx, prod, 2));
+  }
+  yices_expr e = yices_mk_sum(ctx, &terms.front(), terms.size());
+
+  switch(p.op()) {
+  case ops::EQ:  return yices_mk_eq(ctx, e, zero);
+  case ops::NEQ: return yices_mk_diseq(ctx, e, zero);
+  case ops::GT:  return yices_mk_gt(ctx, e, zero);
+  case ops::LE:  return yices_mk_le(ctx, e, zero);
+  case ops::LT:  return yices_mk_lt(ctx, e, zero);
+  case ops::GE:  return yices_mk_ge(ctx, e, zero);
+  default:
+    fprintf(stderr, "Unknown comparison operator: %d\n", p.op());
+    exit(1);
+  }
+}
+
+// Reads the values of 'vars' from the model of (satisfiable) 'ctx'.
+void ReadModel(yices_context ctx, map<var_t,yices_var_decl>& x_decl,
+               const map<var_t,type_t>& vars, map<var_t,value_t>* soln) {
+  typedef map<var_t,type_t>::const_iterator VarIt;
+  yices_model model = yices_get_model(ctx);
+  for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+    long val;
+    int found = yices_get_int_value(model, x_decl[i->first], &val);
+    assert(found);
+    soln->insert(make_pair(i->first, val));
+  }
+}
+
+double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1e6);
+}
+
+// Creates the pipe for a query solved in a forked child.  Both ends are
+// closed on exec, so that they do not leak into the program under test,
+// which runs while speculative queries are pending (see SolverPool).
+void PipeOrDie(int fds[2]) {
+  if (pipe(fds)
+      || (fcntl(fds[0], F_SETFD, FD_CLOEXEC) < 0)
+      || (fcntl(fds[1], F_SETFD, FD_CLOEXEC) < 0)) {
+    perror("Error: Failed to create solver pipe");
+    exit(-1);
+  }
+}
+
+// Reaps the child 'pid', and returns the CPU time it used.
+double ReapChild(pid_t pid) {
+  struct rusage usage;
+  while (wait4(pid, NULL, 0, &usage) < 0) {
+    if (errno != EINTR)
+      return 0;
+  }
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+          + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6);
+}
 
+// Sends the result 'res' of a query solved in a forked child, and (if it
+// is l_true) the values of 'vars' in 'soln', over 'fd', and exits.
+void WriteResultAndExit(int fd, lbool res, const map<var_t,type_t>& vars,
+                        const map<var_t,value_t>& soln) {
+  typedef map<var_t,type_t>::const_iterator VarIt;
+  // The message is the result, followed by the values of 'vars' (in
+  // order) if it is l_true.
+  vector<value_t> msg(1, res);
+  if (res == l_true) {
+    for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+      map<var_t,value_t>::const_iterator v = soln.find(i->first);
+      msg.push_back((v == soln.end()) ? 0 : v->second);
+    }
+  }
+  ssize_t len = msg.size() * sizeof(value_t);
+  _exit(write(fd, &msg.front(), len) == len ? 0 : 1);
+}
+
+// Reads the result of a query solved by child 'pid' (see
+// WriteResultAndExit) from 'fd' until the child closes the pipe (by
+// exiting), or until the 'deadline' (if non-zero), when it is killed.
+// Closes 'fd', reaps the child, and returns l_undef if it timed out.
+// If 'cpu_secs' is non-NULL, sets it to the CPU time the child used.
+lbool ReadResult(pid_t pid, int fd, double deadline,
+                 const map<var_t,type_t>& vars, map<var_t,value_t>* soln,
+                 double* cpu_secs = NULL) {
+  typedef map<var_t,type_t>::const_iterator VarIt;
+
+  vector<value_t> msg(1 + vars.size());
+  char* buff = reinterpret_cast<char*>(&msg.front());
+  const size_t max_len = msg.size() * sizeof(value_t);
+  size_t len = 0;
+  bool timed_out = false;
+  for (;;) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    int ms = -1;
+    if (deadline > 0) {
+      ms = static_cast<int>((deadline - Now()) * 1000);
+      if (ms < 0)
+        ms = 0;
+    }
+    int ready = poll(&pfd, 1, ms);
+    if ((ready < 0) && (errno == EINTR))
+      continue;
+    if (ready == 0) {
+      timed_out = true;
+      kill(pid, SIGKILL);
+      break;
+    }
+    ssize_t n = read(fd, buff + len, max_len - len);
+    if ((n < 0) && (errno == EINTR))
+      continue;
+    if (n <= 0)
+      break;
+    len += n;
+  }
+  close(fd);
+  const double secs = ReapChild(pid);
+  if (cpu_secs)
+    *cpu_secs = secs;
+
+  if (timed_out || (len < sizeof(value_t))) {
+    num_timed_out_queries++;
+    return l_undef;
+  }
+  if (msg[0] != l_true)
+    return static_cast<lbool>(msg[0]);
+  if (len != max_len)
+    return l_undef;
+  size_t j = 1;
+  for (VarIt i = vars.begin(); i != vars.end(); ++i, ++j) {
+    soln->insert(make_pair(i->first, msg[j]));
+  }
+  return l_true;
+}
+
+// Checks 'ctx' and, if it is satisfiable, reads the values of 'vars'
+// into 'soln'.  Returns l_undef if the query timed out.
+//
+// Yices 1 cannot be interrupted, so with a query timeout the check is
+// run in a forked child, which sends back the result and model over a
+// pipe and is killed if it takes too long.  (The context itself is left
+// as it was, so a YicesSession can carry on.)
+lbool CheckContext(yices_context ctx, map<var_t,yices_var_decl>& x_decl,
+                   const map<var_t,type_t>& vars, map<var_t,value_t>* soln) {
+  if (query_timeout <= 0) {
+    lbool res = yices_check(ctx);
+    if (res == l_true) {
+      ReadModel(ctx, x_decl, vars, soln);
+    }
+    return res;
+  }
+
+  int fds[2];
+  PipeOrDie(fds);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("Error: Failed to fork solver");
+    exit(-1);
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    lbool res = yices_check(ctx);
+    if (res == l_true) {
+      ReadModel(ctx, x_decl, vars, soln);
+    }
+    WriteResultAndExit(fds[1], res, vars, *soln);
+  }
+
+  close(fds[1]);
+  return ReadResult(pid, fds[0], Now() + query_timeout, vars, soln);
+}
+
+}  // namespace
+
+
+void YicesSolver::set_query_timeout(double secs) {
+  query_timeout = secs;
+}
+
+
+unsigned int YicesSolver::num_query_timeouts() {
+  return num_timed_out_queries;
+}
+
+
+bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
+				   const map<var_t,type_t>& vars,
+				   const vector<const SymbolicPred*>& constraints,
+				   map<var_t,value_t>* soln,
+				   SolverCache* cache) {
+  vector<const SymbolicPred*> dependent_constraints;
+  SliceConstraints(vars, constraints, &dependent_constraints);
+  if (SolveSlice(old_soln, vars, dependent_constraints, soln, cache)) {
+    // Merge in the constrained variables.
+    MergeOldSolution(old_soln, constraints, soln);
+    return true;
+  }
   return false;
 }
 
 
+bool YicesSolver::SolveSlice(const vector<value_t>& old_soln,
+                             const map<var_t,type_t>& vars,
+                             const vector<const SymbolicPred*>& constraints,
+                             map<var_t,value_t>* soln,
+                             SolverCache* cache) {
+  map<var_t,type_t> dependent_vars;
+  CollectVars(vars, constraints, &dependent_vars);
+
+  soln->clear();
+  bool success;
+  if (!cache || !cache->Lookup(old_soln, dependent_vars, constraints,
+                               &success, soln)) {
+    unsigned int timeouts = num_timed_out_queries;
+    const double start = Now();
+    success = Solve(dependent_vars, constraints, soln);
+    // Do not cache a query which timed out as unsatisfiable.
+    if (cache && (timeouts == num_timed_out_queries)) {
+      cache->Insert(dependent_vars, constraints, success, *soln, Now() - start);
+    }
+  }
+  return success;
+}
+
+
 bool YicesSolver::Solve(const map<var_t,type_t>& vars,
 			const vector<const SymbolicPred*>& constraints,
 			map<var_t,value_t>* soln) {
@@ -141,49 +408,342 @@ bool YicesSolver::Solve(const map<var_t,type_t>& vars,
   yices_expr zero = yices_mk_num(ctx, 0);
   assert(zero);
 
-  { // Constraints.
-    vector<yices_expr> terms;
-    for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
-      const SymbolicExpr& se = (*i)->expr();
-      terms.clear();
-      terms.push_back(yices_mk_num(ctx, se.const_term()));
-      for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
-	yices_expr prod[2] = { x_expr[j->first], yices_mk_num(ctx, j->second) };
-	terms.push_back(yices_mk_mul(ctx, prod, 2));
-      }
-      yices_expr e = yices_mk_sum(ctx, &terms.front(), terms.size());
-
-      yices_expr pred;
-      switch((*i)->op()) {
-      case ops::EQ:  pred = yices_mk_eq(ctx, e, zero); break;
-      case ops::NEQ: pred = yices_mk_diseq(ctx, e, zero); break;
-      case ops::GT:  pred = yices_mk_gt(ctx, e, zero); break;
-      case ops::LE:  pred = yices_mk_le(ctx, e, zero); break;
-      case ops::LT:  pred = yices_mk_lt(ctx, e, zero); break;
-      case ops::GE:  pred = yices_mk_ge(ctx, e, zero); break;
-      default:
-	fprintf(stderr, "Unknown comparison operator: %d\n", (*i)->op());
-	exit(1);
-      }
-      yices_assert(ctx, pred);
+  // Constraints.
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    yices_assert(ctx, MakeYicesPred(ctx, x_expr, zero, **i));
+  }
+
+  soln->clear();
+  bool success = (CheckContext(ctx, x_decl, vars, soln) == l_true);
+
+  yices_del_context(ctx);
+  return success;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+//// YicesSession //////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+struct YicesSession::Context {
+  yices_context ctx;
+  yices_type int_ty;
+  yices_expr zero;
+  vector<yices_expr> min_expr;
+  vector<yices_expr> max_expr;
+
+  // Declared variables.  (Declarations are not undone by yices_pop.)
+  map<var_t,yices_var_decl> x_decl;
+  map<var_t,yices_expr> x_expr;
+  map<var_t,type_t> x_type;
+
+  // Variables whose type bounds are currently asserted, along with the
+  // scope in which they were asserted (in order of increasing scope).
+  set<var_t> bounded;
+  vector< pair<size_t,var_t> > bounds;
+
+  // The asserted constraints -- the i-th is asserted in scope i+1.
+  vector< pair<compare_op_t,SymbolicExpr> > asserted;
+};
+
+
+YicesSession::YicesSession() : ctx_(NULL) { }
+
+YicesSession::~YicesSession() {
+  Reset();
+}
+
+
+void YicesSession::Reset() {
+  if (ctx_) {
+    yices_del_context(ctx_->ctx);
+    delete ctx_;
+    ctx_ = NULL;
+  }
+}
+
+
+void YicesSession::PopTo(size_t num_scopes) {
+  while (ctx_->asserted.size() > num_scopes) {
+    yices_pop(ctx_->ctx);
+    ctx_->asserted.pop_back();
+  }
+  while (!ctx_->bounds.empty() && (ctx_->bounds.back().first > num_scopes)) {
+    ctx_->bounded.erase(ctx_->bounds.back().second);
+    ctx_->bounds.pop_back();
+  }
+}
+
+
+bool YicesSession::Assert(const map<var_t,type_t>& vars, const SymbolicPred& p) {
+  Context& c = *ctx_;
+  yices_push(c.ctx);
+  c.asserted.push_back(make_pair(p.op(), p.expr()));
+  const size_t scope = c.asserted.size();
+
+  for (SymbolicExpr::TermIt i = p.expr().terms().begin();
+       i != p.expr().terms().end(); ++i) {
+    const var_t v = i->first;
+    const type_t ty = vars.find(v)->second;
+
+    if (c.x_decl.find(v) == c.x_decl.end()) {
+      char buff[32];
+      snprintf(buff, sizeof(buff), "x%d", v);
+      c.x_decl[v] = yices_mk_var_decl(c.ctx, buff, c.int_ty);
+      c.x_expr[v] = yices_mk_var_from_decl(c.ctx, c.x_decl[v]);
+      c.x_type[v] = ty;
+      assert(c.x_decl[v]);
+      assert(c.x_expr[v]);
+    } else if (c.x_type[v] != ty) {
+      // The variable has changed type, so its declaration is stale.
+      return false;
+    }
+
+    if (c.bounded.insert(v).second) {
+      c.bounds.push_back(make_pair(scope, v));
+      yices_assert(c.ctx, yices_mk_ge(c.ctx, c.x_expr[v], c.min_expr[ty]));
+      yices_assert(c.ctx, yices_mk_le(c.ctx, c.x_expr[v], c.max_expr[ty]));
     }
   }
 
-  bool success = (yices_check(ctx) == l_true);
-  if (success) {
+  yices_assert(c.ctx, MakeYicesPred(c.ctx, c.x_expr, c.zero, p));
+  return true;
+}
+
+
+bool YicesSession::AssertSlice(const map<var_t,type_t>& vars,
+                               const vector<const SymbolicPred*>& slice) {
+  if (!ctx_) {
+    ctx_ = new Context();
+    Context& c = *ctx_;
+    c.ctx = yices_mk_context();
+    assert(c.ctx);
+
+    // Type limits.
+    c.min_expr.resize(types::LONG_LONG+1);
+    c.max_expr.resize(types::LONG_LONG+1);
+    for (int i = types::U_CHAR; i <= types::LONG_LONG; i++) {
+      c.min_expr[i] = yices_mk_num_from_string(c.ctx, const_cast<char*>(kMinValueStr[i]));
+      c.max_expr[i] = yices_mk_num_from_string(c.ctx, const_cast<char*>(kMaxValueStr[i]));
+      assert(c.min_expr[i]);
+      assert(c.max_expr[i]);
+    }
+
+    char int_ty_name[] = "int";
+    c.int_ty = yices_mk_type(c.ctx, int_ty_name);
+    assert(c.int_ty);
+    c.zero = yices_mk_num(c.ctx, 0);
+    assert(c.zero);
+  }
+
+  // Only the slice is asserted.  (A constraint outside it may be
+  // unsatisfiable over the unbounded integers -- e.g. one recorded after
+  // a C overflow -- and would make every later query fail.)  Pop back to
+  // the longest prefix shared with the previous query's slice, and assert
+  // the remaining constraints (except the last) on top of it.
+  const size_t prefix_len = slice.size() - 1;
+  size_t common = 0;
+  while ((common < prefix_len) && (common < ctx_->asserted.size())
+         && (ctx_->asserted[common].first == slice[common]->op())
+         && (ctx_->asserted[common].second == slice[common]->expr())) {
+    common++;
+  }
+  PopTo(common);
+
+  for (size_t i = common; i <= prefix_len; i++) {
+    if (!Assert(vars, *slice[i]))
+      return false;
+  }
+  return true;
+}
+
+
+bool YicesSession::IncrementalSolve(const vector<value_t>& old_soln,
+                                    const map<var_t,type_t>& vars,
+                                    const vector<const SymbolicPred*>& constraints,
+                                    map<var_t,value_t>* soln,
+                                    SolverCache* cache) {
+  vector<const SymbolicPred*> dependent_constraints;
+  SliceConstraints(vars, constraints, &dependent_constraints);
+  return IncrementalSolve(old_soln, vars, constraints, dependent_constraints,
+                          soln, cache);
+}
+
+
+bool YicesSession::IncrementalSolve(const vector<value_t>& old_soln,
+                                    const map<var_t,type_t>& vars,
+                                    const vector<const SymbolicPred*>& constraints,
+                                    const vector<const SymbolicPred*>& dependent_constraints,
+                                    map<var_t,value_t>* soln,
+                                    SolverCache* cache) {
+  // The variables on which the last constraint depends.
+  map<var_t,type_t> dependent_vars;
+  CollectVars(vars, dependent_constraints, &dependent_vars);
+
+  if (cache) {
+    bool success;
     soln->clear();
-    yices_model model = yices_get_model(ctx);
-    for (VarIt i = vars.begin(); i != vars.end(); ++i) {
-      long val;
-      assert(yices_get_int_value(model, x_decl[i->first], &val));
-      soln->insert(make_pair(i->first, val));
+    if (cache->Lookup(old_soln, dependent_vars, dependent_constraints,
+                      &success, soln)) {
+      if (success) {
+        MergeOldSolution(old_soln, constraints, soln);
+      }
+      return success;
     }
   }
 
-  yices_del_context(ctx);
+  // Start over with a fresh context if the slice cannot be asserted in
+  // the current one.  (A fresh context declares each variable with its
+  // type in 'vars', so the second attempt succeeds.)
+  if (!AssertSlice(vars, dependent_constraints)) {
+    Reset();
+    AssertSlice(vars, dependent_constraints);
+  }
+  const size_t prefix_len = dependent_constraints.size() - 1;
+
+  // Take new values only for the variables on which the last constraint
+  // depends, as YicesSolver::IncrementalSolve does.
+  soln->clear();
+  const double start = Now();
+  lbool res = CheckContext(ctx_->ctx, ctx_->x_decl, dependent_vars, soln);
+  bool success = (res == l_true);
+  // Do not cache a query which timed out as unsatisfiable.
+  if (cache && (res != l_undef)) {
+    cache->Insert(dependent_vars, dependent_constraints, success, *soln,
+                  Now() - start);
+  }
+  if (success) {
+    MergeOldSolution(old_soln, constraints, soln);
+  }
+
+  // Drop the last constraint, keeping the prefix for the next query.
+  PopTo(prefix_len);
   return success;
 }
 
 
-}  // namespace crest
+SolverPool::SolverPool() : size_(0), solver_time_(0) { }
+
+
+SolverPool::~SolverPool() {
+  Clear();
+}
+
+
+vector<SolverPool::Job>::iterator SolverPool::Find(const Key& key) {
+  vector<Job>::iterator i = jobs_.begin();
+  while ((i != jobs_.end()) && (i->key != key))
+    ++i;
+  return i;
+}
+
+
+bool SolverPool::IsPending(const Key& key) const {
+  for (size_t i = 0; i < jobs_.size(); i++) {
+    if (jobs_[i].key == key)
+      return true;
+  }
+  return false;
+}
+
+
+void SolverPool::Start(const Key& key,
+                       const map<var_t,type_t>& vars,
+                       const vector<const SymbolicPred*>& constraints) {
+  assert(!IsPending(key));
+
+  int fds[2];
+  PipeOrDie(fds);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("Error: Failed to fork solver");
+    exit(-1);
+  }
+
+  if (pid == 0) {
+    // The parent enforces the timeout (see Finish).
+    close(fds[0]);
+    query_timeout = 0;
+    map<var_t,type_t> dependent_vars;
+    CollectVars(vars, constraints, &dependent_vars);
+    map<var_t,value_t> soln;
+    bool success = YicesSolver::Solve(dependent_vars, constraints, &soln);
+    WriteResultAndExit(fds[1], success ? l_true : l_false,
+                       dependent_vars, soln);
+  }
+
+  close(fds[1]);
+  Job job = { key, pid, fds[0], 0 };
+  if (query_timeout > 0) {
+    job.deadline = Now() + query_timeout;
+  }
+  jobs_.push_back(job);
+}
 
+
+bool SolverPool::Finish(const Key& key,
+                        const vector<value_t>& old_soln,
+                        const map<var_t,type_t>& vars,
+                        const vector<const SymbolicPred*>& constraints,
+                        map<var_t,value_t>* soln,
+                        SolverCache* cache) {
+  map<var_t,type_t> dependent_vars;
+  CollectVars(vars, constraints, &dependent_vars);
+
+  soln->clear();
+  bool success;
+  if (cache && cache->Lookup(old_soln, dependent_vars, constraints,
+                             &success, soln)) {
+    Discard(key);
+    return success;
+  }
+
+  vector<Job>::iterator job = Find(key);
+  assert(job != jobs_.end());
+  double secs;
+  lbool res = ReadResult(job->pid, job->fd, job->deadline,
+                         dependent_vars, soln, &secs);
+  jobs_.erase(job);
+  solver_time_ += secs;
+  success = (res == l_true);
+  // Do not cache a query which timed out as unsatisfiable.
+  if (cache && (res != l_undef)) {
+    cache->Insert(dependent_vars, constraints, success, *soln, secs);
+  }
+  return success;
+}
+
+
+void SolverPool::Discard(const Key& key) {
+  vector<Job>::iterator job = Find(key);
+  if (job == jobs_.end())
+    return;
+  kill(job->pid, SIGKILL);
+  close(job->fd);
+  solver_time_ += ReapChild(job->pid);
+  jobs_.erase(job);
+}
+
+
+void SolverPool::DiscardGroup(const void* group) {
+  for (size_t i = jobs_.size(); i-- > 0; ) {
+    if (jobs_[i].key.first == group)
+      Discard(jobs_[i].key);
+  }
+}
+
+
+void SolverPool::Clear() {
+  while (!jobs_.empty()) {
+    Discard(jobs_.back().key);
+  }
+}
+
+
+double SolverPool::TakeSolverTime() {
+  double secs = solver_time_;
+  solver_time_ = 0;
+  return secs;
+}
+
+}  // namespace crest
@@ -12,22 +12,39 @@
 #define BASE_YICES_SOLVER_H__
 
 #include <map>
+#include <sys/types.h>
+#include <utility>
 #include <vector>
 
 #include "base/basic_types.h"
+#include "base/solver_cache.h"
 #include "base/symbolic_predicate.h"
 
 using std::map;
+using std::pair;
 using std::vector;
 
 namespace crest {
 
 class YicesSolver {
  public:
+  // Solves the constraints on which the last constraint depends.  If
+  // 'cache' is non-NULL, it is consulted before calling the solver (with
+  // the dependent constraints as the key) and updated after.
   static bool IncrementalSolve(const vector<value_t>& old_soln,
 			       const map<var_t,type_t>& vars,
                                const vector<const SymbolicPred*>& constraints,
-			       map<var_t,value_t>* soln);
+			       map<var_t,value_t>* soln,
+			       SolverCache* cache = NULL);
+
+  // As IncrementalSolve, but 'constraints' must already be closed under
+  // dependence -- the last constraint and exactly those constraints which
+  // it depends on (e.g. from SymbolicPath::DependentConstraints).
+  static bool SolveSlice(const vector<value_t>& old_soln,
+                         const map<var_t,type_t>& vars,
+                         const vector<const SymbolicPred*>& constraints,
+                         map<var_t,value_t>* soln,
+                         SolverCache* cache = NULL);
 
   static bool Solve(const map<var_t,type_t>& vars,
                     const vector<const SymbolicPred*>& constraints,
@@ -35,6 +52,146 @@ class YicesSolver {
 
   static bool ReadSolutionFromFileOrDie(const string& file,
                                         map<var_t,value_t>* soln);
+
+  // Gives up on any query (by YicesSolver or a YicesSession) which takes
+  // longer than 'secs' seconds, treating it as a failure to solve.  (Zero,
+  // the default, means no timeout.)
+  static void set_query_timeout(double secs);
+
+  // The number of queries given up on so far.
+  static unsigned int num_query_timeouts();
+};
+
+
+// An incremental solver session, which keeps one Yices context alive
+// across queries.
+//
+// The constraints of each query's slice (the last constraint and those
+// it depends on) are kept asserted, one push()-ed scope per constraint,
+// so that a following query only has to pop back to the prefix its slice
+// shares with the previous one and then assert the rest.  The last
+// constraint of a query is asserted in a temporary scope of its own.
+// Thus, consecutive queries on the same path (e.g. negating successive
+// branches in a depth-first search) do not re-declare the variables or
+// re-assert the shared prefix, and a constraint outside the slice cannot
+// make a query unsatisfiable.
+class YicesSession {
+ public:
+  YicesSession();
+  ~YicesSession();
+
+  // Same contract as YicesSolver::IncrementalSolve -- the solution gives
+  // new values only for the variables that the last constraint depends
+  // on, and the old values for all other constrained variables.
+  bool IncrementalSolve(const vector<value_t>& old_soln,
+                        const map<var_t,type_t>& vars,
+                        const vector<const SymbolicPred*>& constraints,
+                        map<var_t,value_t>* soln,
+                        SolverCache* cache = NULL);
+
+  // As above, with the constraints on which the last one depends given
+  // in 'dependent_constraints' (see YicesSolver::SolveSlice) rather than
+  // recomputed.
+  bool IncrementalSolve(const vector<value_t>& old_soln,
+                        const map<var_t,type_t>& vars,
+                        const vector<const SymbolicPred*>& constraints,
+                        const vector<const SymbolicPred*>& dependent_constraints,
+                        map<var_t,value_t>* soln,
+                        SolverCache* cache = NULL);
+
+  // Discards the Yices context and everything asserted in it.
+  void Reset();
+
+ private:
+  struct Context;
+  Context* ctx_;
+
+  void PopTo(size_t num_scopes);
+  bool Assert(const map<var_t,type_t>& vars, const SymbolicPred& p);
+
+  // Asserts the constraints in 'slice', keeping those already asserted in
+  // the context (which is created if needed).  Returns false if the
+  // context must be reset first.
+  bool AssertSlice(const map<var_t,type_t>& vars,
+                   const vector<const SymbolicPred*>& slice);
+
+  // Disallow copying.
+  YicesSession(const YicesSession&);
+  void operator=(const YicesSession&);
+};
+
+
+// A pool of solver processes, for solving queries speculatively -- e.g.
+// the next few candidate branches of a search, while the program under
+// test runs on the current one.
+//
+// Yices 1 keeps global state and cannot be used from several threads, so
+// each query is solved in a forked child process, with its own Yices
+// context, which sends back the result over a pipe (as with a query
+// timeout; see YicesSolver::set_query_timeout).  Up to size() queries
+// are solved at once.
+class SolverPool {
+ public:
+  // A query is keyed by a group (e.g. the execution whose constraints it
+  // solves) and an index in that group (e.g. of the negated constraint).
+  typedef pair<const void*,size_t> Key;
+
+  SolverPool();
+  ~SolverPool();
+
+  // The number of queries solved at once.  Zero (the default) disables
+  // the pool.
+  void set_size(size_t n) { size_ = n; }
+  size_t size() const { return size_; }
+  bool full() const { return jobs_.size() >= size_; }
+
+  // Starts solving 'constraints' -- closed under dependence, as for
+  // YicesSolver::SolveSlice -- under 'key'.  The query timeout (if any)
+  // counts from now.
+  void Start(const Key& key,
+             const map<var_t,type_t>& vars,
+             const vector<const SymbolicPred*>& constraints);
+
+  bool IsPending(const Key& key) const;
+
+  // Same contract as YicesSolver::SolveSlice, for the query started under
+  // 'key' (which must be given the same constraints), waiting for it to
+  // finish.  If 'cache' already has the answer, the query is discarded
+  // instead.  The query is cached with the CPU time of its process.
+  bool Finish(const Key& key,
+              const vector<value_t>& old_soln,
+              const map<var_t,type_t>& vars,
+              const vector<const SymbolicPred*>& constraints,
+              map<var_t,value_t>* soln,
+              SolverCache* cache = NULL);
+
+  // Kills the query started under 'key', all pending queries of 'group',
+  // or all pending queries.
+  void Discard(const Key& key);
+  void DiscardGroup(const void* group);
+  void Clear();
+
+  // Returns the CPU time used by the solver processes reaped (for finished
+  // or discarded queries) since the last call.
+  double TakeSolverTime();
+
+ private:
+  struct Job {
+    Key key;
+    pid_t pid;
+    int fd;
+    double deadline;  // Zero if none.
+  };
+
+  size_t size_;
+  vector<Job> jobs_;
+  double solver_time_;
+
+  vector<Job>::iterator Find(const Key& key);
+
+  // Disallow copying.
+  SolverPool(const SolverPool&);
+  void operator=(const SolverPool&);
 };
 
 }  // namespace crest
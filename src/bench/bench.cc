@@ -0,0 +1,553 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/execution_view.h"
+#include "base/symbolic_execution.h"
+#include "base/symbolic_expression.h"
+#include "base/symbolic_interpreter.h"
+#include "base/symbolic_predicate.h"
+#include "base/yices_solver.h"
+
+using namespace crest;
+using namespace std;
+
+// Microbenchmarks for the symbolic core and for process_cfg.
+//
+// Each benchmark prints one line of JSON to stdout:
+//   {"benchmark": NAME, "iterations": N, "seconds": S, "ns_per_op": T}
+// where an "op" is the unit of work named in the benchmark's comment.
+// Run as "bench [-process_cfg PATH] [NAME...]" to run only the named
+// benchmarks.  (See "make bench".)
+
+namespace {
+
+double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+void Report(const char* name, size_t iters, double secs) {
+  printf("{\"benchmark\": \"%s\", \"iterations\": %zu, "
+         "\"seconds\": %.6f, \"ns_per_op\": %.2f}\n",
+         name, iters, secs, 1e9 * secs / iters);
+  fflush(stdout);
+}
+
+// Keeps the compiler from optimizing away a benchmark's result.
+volatile value_t sink;
+
+// Op: one SymbolicExpr +=, -=, or *=, on expressions over 8 variables.
+void BenchExprArith() {
+  const size_t kIters = 1000000;
+  SymbolicExpr terms[8];
+  for (var_t v = 0; v < 8; v++) {
+    terms[v] = SymbolicExpr(v + 1, v);
+    terms[v] += 7;
+  }
+
+  double start = Now();
+  // Multiplying by -1 keeps the coefficients small (at most 14), so
+  // that they cannot overflow.
+  SymbolicExpr acc(0);
+  for (size_t i = 0; i < kIters; i += 3) {
+    acc += terms[i % 8];
+    acc *= -1;
+    acc -= terms[(i + 3) % 8];
+  }
+  Report("expr_arith", kIters, Now() - start);
+  sink = acc.const_term();
+}
+
+// Builds an execution of 'n' symbolic branches over 8 inputs, each
+// on the sum of an input and the previous sum.  Returns the number of
+// calls made to the interpreter.
+size_t RunInterpreter(SymbolicInterpreter* si, size_t n) {
+  static int mem[10];
+  for (int i = 0; i < 8; i++) {
+    mem[i] = si->NewInput(types::INT, (addr_t)&mem[i]);
+  }
+
+  size_t calls = 8;
+  for (size_t i = 0; i < n; i++) {
+    // mem[8] = mem[8] + mem[i % 8];
+    si->Load(0, (addr_t)&mem[8], mem[8]);
+    si->Load(0, (addr_t)&mem[i % 8], mem[i % 8]);
+    mem[8] += mem[i % 8];
+    si->ApplyBinaryOp(0, ops::ADD, mem[8]);
+    si->Store(0, (addr_t)&mem[8]);
+    // if (mem[8] > 0)
+    si->Load(0, (addr_t)&mem[8], mem[8]);
+    si->Load(0, 0, 0);
+    si->ApplyCompareOp(0, ops::GT, mem[8] > 0);
+    si->Branch(0, 2 * (i % 1000), mem[8] > 0);
+    calls += 8;
+  }
+  return calls;
+}
+
+// Op: one Load, Store, Apply, or Branch call on the interpreter.
+void BenchInterpreter() {
+  const size_t kBranches = 100000;
+  vector<value_t> input(8, 1);
+  SymbolicInterpreter si(input);
+  double start = Now();
+  size_t calls = RunInterpreter(&si, kBranches);
+  Report("interpreter", calls, Now() - start);
+}
+
+// Op: one branch of an execution, serialized and then parsed back.
+void BenchSerializeParse() {
+  const size_t kBranches = 20000;
+  const size_t kRounds = 20;
+  vector<value_t> input(8, 1);
+  SymbolicInterpreter si(input);
+  RunInterpreter(&si, kBranches);
+
+  double start = Now();
+  string buff;
+  for (size_t i = 0; i < kRounds; i++) {
+    buff.clear();
+    si.execution().Serialize(&buff);
+    SymbolicExecution ex;
+    istringstream in(buff);
+    if (!ex.Parse(in)) {
+      fprintf(stderr, "serialize_parse: failed to parse execution.\n");
+      exit(1);
+    }
+  }
+  Report("serialize_parse", kRounds * kBranches, Now() - start);
+}
+
+// Writes the trace of an execution of 'n' symbolic branches over 64
+// inputs, each on a single input (x_{i % 64} > i), to a new temporary
+// file.  Returns the file's name.
+string WriteTrace(size_t n) {
+  static int mem[64];
+  vector<value_t> input(64, 0);
+  SymbolicInterpreter si(input);
+  for (int i = 0; i < 64; i++) {
+    mem[i] = si.NewInput(types::INT, (addr_t)&mem[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    const bool b = (mem[i % 64] > static_cast<int>(i));
+    si.Load(0, (addr_t)&mem[i % 64], mem[i % 64]);
+    si.Load(0, 0, i);
+    si.ApplyCompareOp(0, ops::GT, b);
+    si.Branch(0, 2 * (i % 1000), b);
+  }
+
+  string buff;
+  si.execution().Serialize(&buff);
+  char file[] = "/tmp/crest_bench_trace.XXXXXX";
+  int fd = mkstemp(file);
+  if ((fd < 0)
+      || (write(fd, buff.data(), buff.size()) != (ssize_t)buff.size())) {
+    perror("trace: mkstemp");
+    exit(1);
+  }
+  close(fd);
+  return file;
+}
+
+// Op: one branch of an execution, read from its trace file by
+// SymbolicExecution::Parse, followed by slicing its last constraint.
+void BenchParseExecution() {
+  const size_t kBranches = 20000;
+  const size_t kRounds = 20;
+  const string file = WriteTrace(kBranches);
+
+  double start = Now();
+  vector<size_t> slice;
+  for (size_t i = 0; i < kRounds; i++) {
+    SymbolicExecution ex;
+    ifstream in(file.c_str(), ios::in | ios::binary);
+    if (!ex.Parse(in)) {
+      fprintf(stderr, "parse_execution: failed to parse execution.\n");
+      exit(1);
+    }
+    ex.path().DependentConstraints(kBranches - 1, &slice);
+  }
+  Report("parse_execution", kRounds * kBranches, Now() - start);
+  unlink(file.c_str());
+}
+
+// Op: as for parse_execution, but reading the trace through a (detached)
+// ExecutionView, which decodes only the constraints in the slice.
+void BenchViewExecution() {
+  const size_t kBranches = 20000;
+  const size_t kRounds = 20;
+  const string file = WriteTrace(kBranches);
+
+  double start = Now();
+  ExecutionView view;
+  vector<size_t> slice;
+  for (size_t i = 0; i < kRounds; i++) {
+    if (!view.Open(file)) {
+      fprintf(stderr, "view_execution: failed to open execution.\n");
+      exit(1);
+    }
+    view.Detach();
+    view.DependentConstraints(kBranches - 1, &slice);
+    for (size_t j = 0; j < slice.size(); j++) {
+      delete view.NewPred(slice[j]);
+    }
+  }
+  Report("view_execution", kRounds * kBranches, Now() - start);
+  unlink(file.c_str());
+}
+
+// Builds 'n' satisfiable linear constraints over 'n' + 1 variables:
+//   x_i + x_{i+1} >= i  and, last,  x_0 - x_n == 3.
+void MakeConstraints(size_t n, map<var_t,type_t>* vars,
+                     vector<const SymbolicPred*>* constraints) {
+  for (var_t v = 0; v <= n; v++) {
+    (*vars)[v] = types::INT;
+  }
+  for (var_t v = 0; v + 1 < n; v++) {
+    SymbolicExpr* e = new SymbolicExpr(1, v);
+    *e += SymbolicExpr(1, v + 1);
+    *e -= v;
+    constraints->push_back(new SymbolicPred(ops::GE, e));
+  }
+  SymbolicExpr* e = new SymbolicExpr(1, 0);
+  *e -= SymbolicExpr(1, n);
+  *e -= 3;
+  constraints->push_back(new SymbolicPred(ops::EQ, e));
+}
+
+// Op: one call to YicesSolver::Solve on 32 chained constraints.
+void BenchSolve() {
+  const size_t kIters = 200;
+  map<var_t,type_t> vars;
+  vector<const SymbolicPred*> constraints;
+  MakeConstraints(32, &vars, &constraints);
+
+  double start = Now();
+  map<var_t,value_t> soln;
+  for (size_t i = 0; i < kIters; i++) {
+    soln.clear();
+    if (!YicesSolver::Solve(vars, constraints, &soln)) {
+      fprintf(stderr, "solve: constraints found unsatisfiable.\n");
+      exit(1);
+    }
+  }
+  Report("solve", kIters, Now() - start);
+}
+
+// Op: one call to YicesSolver::IncrementalSolve on 32 chained constraints.
+void BenchIncrementalSolve() {
+  const size_t kIters = 200;
+  map<var_t,type_t> vars;
+  vector<const SymbolicPred*> constraints;
+  MakeConstraints(32, &vars, &constraints);
+  vector<value_t> old_soln(vars.size(), 0);
+
+  double start = Now();
+  map<var_t,value_t> soln;
+  for (size_t i = 0; i < kIters; i++) {
+    soln.clear();
+    if (!YicesSolver::IncrementalSolve(old_soln, vars, constraints, &soln)) {
+      fprintf(stderr, "incremental_solve: constraints found unsatisfiable.\n");
+      exit(1);
+    }
+  }
+  Report("incremental_solve", kIters, Now() - start);
+}
+
+// Writes a synthetic instrumented program's "cfg", "cfg_func_map", and
+// "branches" (see process_cfg) to the current directory: 'num_funcs'
+// functions, each a chain of 'num_ifs' if-statements, with every eighth
+// then-branch calling the next function.
+void WriteCfg(int num_funcs, int num_ifs) {
+  ofstream cfg("cfg"), func_map("cfg_func_map"), branches("branches");
+  int sid = 1;
+  for (int f = 0; f < num_funcs; f++) {
+    func_map << "f" << f << " " << sid << "\n";
+    branches << (f + 1) << " " << num_ifs << "\n";
+    for (int i = 0; i < num_ifs; i++, sid += 3) {
+      // sid: "if", sid+1: then-block, sid+2: else-block.
+      cfg << sid << " " << (sid + 1) << " " << (sid + 2) << "\n";
+      cfg << (sid + 1) << " " << (sid + 3);
+      if ((i % 8 == 0) && (f + 1 < num_funcs))
+        cfg << " f" << (f + 1);
+      cfg << "\n";
+      cfg << (sid + 2) << " " << (sid + 3) << "\n";
+      branches << (sid + 1) << " " << (sid + 2) << "\n";
+    }
+    // The function's return.
+    cfg << sid++ << "\n";
+  }
+}
+
+// Appends 'x' to 'out' as a big-endian 32-bit integer, as in a CFG
+// fragment (see crestInstrument.ml).
+void AppendInt(string* out, int x) {
+  unsigned u = x;
+  char b[4] = { (char)(u >> 24), (char)(u >> 16), (char)(u >> 8), (char)u };
+  out->append(b, 4);
+}
+
+// Writes the same program as WriteCfg, but as CFG fragments in
+// cfg_fragments/: 'num_files' files of 'funcs_per_file' functions each.
+// A call to a function in another file is by name.  Writing with a
+// different 'version' changes the contents (but not the CFG) of file 0.
+void WriteFragments(int num_files, int funcs_per_file, int num_ifs,
+                    int version) {
+  if (mkdir("cfg_fragments", 0755) && (errno != EEXIST)) {
+    perror("process_cfg: mkdir");
+    exit(1);
+  }
+  const int num_funcs = num_files * funcs_per_file;
+  const int func_size = 3 * num_ifs + 1;
+  for (int k = 0; k < num_files; k++) {
+    // Names: this file's functions, then the one called in the next file
+    // (and, to change the contents, a version).
+    const int first_func = k * funcs_per_file;
+    vector<string> names;
+    for (int f = first_func; f <= first_func + funcs_per_file; f++) {
+      ostringstream name;
+      name << "f" << f;
+      names.push_back(name.str());
+    }
+    if ((k == 0) && (version > 0)) {
+      ostringstream name;
+      name << "version" << version;
+      names.push_back(name.str());
+    }
+
+    string out("CRCF");
+    AppendInt(&out, 1);
+    AppendInt(&out, names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+      AppendInt(&out, names[i].size());
+      out += names[i];
+    }
+    AppendInt(&out, funcs_per_file);
+    for (int f = first_func; f < first_func + funcs_per_file; f++) {
+      int sid = 1 + f * func_size;
+      AppendInt(&out, f - first_func);  // Name.
+      AppendInt(&out, 0);               // Not static.
+      AppendInt(&out, f + 1);           // Function id.
+      AppendInt(&out, sid);
+      AppendInt(&out, num_ifs);
+      for (int i = 0; i < num_ifs; i++) {
+        AppendInt(&out, sid + 3 * i + 1);
+        AppendInt(&out, sid + 3 * i + 2);
+      }
+      AppendInt(&out, func_size);
+      for (int i = 0; i < num_ifs; i++, sid += 3) {
+        // sid: "if", sid+1: then-block, sid+2: else-block.
+        AppendInt(&out, sid);
+        AppendInt(&out, 2);
+        AppendInt(&out, sid + 1);
+        AppendInt(&out, sid + 2);
+        AppendInt(&out, 0);
+
+        AppendInt(&out, sid + 1);
+        AppendInt(&out, 1);
+        AppendInt(&out, sid + 3);
+        if ((i % 8 == 0) && (f + 1 < num_funcs)) {
+          AppendInt(&out, 1);
+          if (f + 1 < first_func + funcs_per_file) {
+            AppendInt(&out, 1 + (f + 1) * func_size);
+          } else {
+            AppendInt(&out, -1 - funcs_per_file);
+          }
+        } else {
+          AppendInt(&out, 0);
+        }
+
+        AppendInt(&out, sid + 2);
+        AppendInt(&out, 1);
+        AppendInt(&out, sid + 3);
+        AppendInt(&out, 0);
+      }
+      // The function's return.
+      AppendInt(&out, sid);
+      AppendInt(&out, 0);
+      AppendInt(&out, 0);
+    }
+
+    ostringstream fname;
+    fname << "cfg_fragments/file" << k << ".c";
+    ofstream file(fname.str().c_str(), ios::out | ios::binary);
+    file.write(out.data(), out.size());
+    if (!file) {
+      fprintf(stderr, "process_cfg: failed to write %s.\n",
+              fname.str().c_str());
+      exit(1);
+    }
+  }
+}
+
+// Creates a scratch directory and makes it the current directory, saving
+// the old one in 'cwd'.
+void EnterScratchDir(char* dir, string* cwd) {
+  char buff[4096];
+  if (!getcwd(buff, sizeof(buff)) || !mkdtemp(dir) || chdir(dir)) {
+    perror("process_cfg: scratch directory");
+    exit(1);
+  }
+  *cwd = buff;
+}
+
+void LeaveScratchDir(const char* dir, const string& cwd) {
+  string cmd = string("rm -rf ") + dir;
+  if (chdir(cwd.c_str()) || system(cmd.c_str())) {
+    perror("process_cfg: cleanup");
+  }
+}
+
+// Makes 'path' absolute if it is relative to the current directory --
+// i.e. if it has a directory, and so is not looked up in $PATH.
+string AbsolutePath(const string& path) {
+  char cwd[4096];
+  if ((path.find('/') == string::npos) || (path[0] == '/')
+      || !getcwd(cwd, sizeof(cwd)))
+    return path;
+  return string(cwd) + "/" + path;
+}
+
+// Runs process_cfg in the scratch directory 'dir', and returns its time.
+double RunProcessCfg(const string& process_cfg,
+                     const char* dir, const string& cwd) {
+  string cmd = process_cfg + " > /dev/null 2>&1";
+  double start = Now();
+  int status = system(cmd.c_str());
+  double secs = Now() - start;
+  if (status != 0) {
+    LeaveScratchDir(dir, cwd);
+    fprintf(stderr, "process_cfg: \"%s\" failed with status %d.  (Pass "
+            "-process_cfg PATH, or run \"make bench\".)\n",
+            process_cfg.c_str(), status);
+    exit(1);
+  }
+  return secs;
+}
+
+// Op: one branch of the CFG, processed by process_cfg from the text CFG.
+void BenchProcessCfg(const string& process_cfg) {
+  const int kFuncs = 20, kIfs = 250;
+  char dir[] = "/tmp/crest_bench.XXXXXX";
+  string cwd;
+  EnterScratchDir(dir, &cwd);
+  WriteCfg(kFuncs, kIfs);
+  double secs = RunProcessCfg(process_cfg, dir, cwd);
+  LeaveScratchDir(dir, cwd);
+  Report("process_cfg", 2 * kFuncs * kIfs, secs);
+}
+
+// Op: one branch of the CFG, processed by process_cfg from the CFG
+// fragments of 'num_files' files: with no cache ("NAME"), rerun with an
+// up-to-date cache ("NAME_warm"), and rerun after one file has changed
+// ("NAME_one_changed").
+void BenchProcessFragments(const string& process_cfg, const char* name,
+                           int num_files, int funcs_per_file, int num_ifs) {
+  const size_t num_branches = 2 * num_files * funcs_per_file * num_ifs;
+  char dir[] = "/tmp/crest_bench.XXXXXX";
+  string cwd;
+  EnterScratchDir(dir, &cwd);
+  WriteFragments(num_files, funcs_per_file, num_ifs, 0);
+  const double cold = RunProcessCfg(process_cfg, dir, cwd);
+  const double warm = RunProcessCfg(process_cfg, dir, cwd);
+  WriteFragments(num_files, funcs_per_file, num_ifs, 1);
+  const double changed = RunProcessCfg(process_cfg, dir, cwd);
+  LeaveScratchDir(dir, cwd);
+
+  const string n(name);
+  Report(n.c_str(), num_branches, cold);
+  Report((n + "_warm").c_str(), num_branches, warm);
+  Report((n + "_one_changed").c_str(), num_branches, changed);
+}
+
+void BenchProcessCfgFragments(const string& process_cfg) {
+  // The same program as process_cfg, in 10 files.
+  BenchProcessFragments(process_cfg, "process_cfg_fragments", 10, 2, 250);
+}
+
+void BenchProcessCfgLarge(const string& process_cfg) {
+  // About 1M CFG nodes and 667K branches, in 100 files.
+  BenchProcessFragments(process_cfg, "process_cfg_large", 100, 10, 333);
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+  // By default, the process_cfg built alongside this binary.
+  string process_cfg = "process_cfg";
+  const char* slash = strrchr(argv[0], '/');
+  if (slash) {
+    process_cfg = string(argv[0], slash - argv[0]) + "/../process_cfg/process_cfg";
+  }
+  vector<string> names;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-process_cfg") && (i + 1 < argc)) {
+      process_cfg = argv[++i];
+    } else {
+      names.push_back(argv[i]);
+    }
+  }
+  // process_cfg is run from a scratch directory.
+  process_cfg = AbsolutePath(process_cfg);
+
+  struct {
+    const char* name;
+    void (*run)();
+  } benchmarks[] = {
+    { "expr_arith", BenchExprArith },
+    { "interpreter", BenchInterpreter },
+    { "serialize_parse", BenchSerializeParse },
+    { "parse_execution", BenchParseExecution },
+    { "view_execution", BenchViewExecution },
+    { "solve", BenchSolve },
+    { "incremental_solve", BenchIncrementalSolve },
+  };
+
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    if (names.empty()
+        || (find(names.begin(), names.end(), benchmarks[i].name) != names.end()))
+      benchmarks[i].run();
+  }
+  struct {
+    const char* name;
+    void (*run)(const string& process_cfg);
+  } process_cfg_benchmarks[] = {
+    { "process_cfg", BenchProcessCfg },
+    { "process_cfg_fragments", BenchProcessCfgFragments },
+    { "process_cfg_large", BenchProcessCfgLarge },
+  };
+
+  const size_t n = sizeof(process_cfg_benchmarks)
+                   / sizeof(process_cfg_benchmarks[0]);
+  for (size_t i = 0; i < n; i++) {
+    const char* name = process_cfg_benchmarks[i].name;
+    if (names.empty() || (find(names.begin(), names.end(), name) != names.end()))
+      process_cfg_benchmarks[i].run(process_cfg);
+  }
+
+  return 0;
+}
@@ -9,11 +9,21 @@
 // for details.
 
 #include <assert.h>
+#include <fcntl.h>
 #include <fstream>
+#include <stdlib.h>
 #include <string>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
+#include "base/event_buffer.h"
+#include "base/execution_trace.h"
+#include "base/fork_server.h"
+#include "base/shm_transport.h"
 #include "base/symbolic_interpreter.h"
 #include "libcrest/crest.h"
 
@@ -25,8 +35,26 @@ static SymbolicInterpreter* SI;
 
 // Have we read an input yet?  Until we have, generate only the
 // minimal instrumentation necessary to track which branches were
-// reached by the execution path.
-static int pre_symbolic;
+// reached by the execution path.  (Exported for the inline
+// instrumentation functions in libcrest/crest_inline.h.)
+int __CrestPreSymbolic = 1;
+
+// In batch mode (see base/event_buffer.h), the instrumentation functions
+// append events to event_buffer, rather than calling SI directly.
+static EventBuffer* event_buffer;
+
+// Shared-memory file to which to write the execution, or -1 to write it
+// to the file "szd_execution".  (See base/shm_transport.h.)
+static int execution_fd = -1;
+
+// The execution is written out as a trace (see base/execution_trace.h)
+// while it runs, a chunk of kTraceChunk branches at a time, to trace_fd.
+static const unsigned int kTraceChunk = 4096;
+static TraceWriter* trace_writer;
+static string trace_buff;
+static int trace_fd = -1;
+static off_t trace_offset;
+static unsigned int num_unwritten_branches;
 
 // Tables for converting from operators defined in libcrest/crest.h to
 // those defined in base/basic_types.h.
@@ -47,9 +75,17 @@ static const int kOpTable[] =
 
 
 static void __CrestAtExit();
+static void __CrestForkServer();
+static void __CrestWriteTrace(bool finish);
 
 
 void __CrestInit() {
+  // If run_crest started us as a fork server, only forked children
+  // (one per run requested by run_crest) return from here.
+  if (getenv(kForkServerEnv)) {
+    __CrestForkServer();
+  }
+
   // Initialize the random number generator.
   struct timeval tv;
   gettimeofday(&tv, NULL);
@@ -57,32 +93,112 @@ void __CrestInit() {
 
   // Read the input.
   vector<value_t> input;
-  std::ifstream in("input");
-  value_t val;
-  while (in >> val) {
-    input.push_back(val);
+  if (getenv(kInputFdEnv)) {
+    int fd = atoi(getenv(kInputFdEnv));
+    struct stat st;
+    if (!fstat(fd, &st)) {
+      input.resize(st.st_size / sizeof(value_t));
+      ssize_t len = input.size() * sizeof(value_t);
+      if ((len > 0) && (pread(fd, &input.front(), len, 0) != len))
+        input.clear();
+    }
+    execution_fd = atoi(getenv(kExecutionFdEnv));
+  } else {
+    std::ifstream in("input");
+    value_t val;
+    while (in >> val) {
+      input.push_back(val);
+    }
+    in.close();
   }
-  in.close();
 
   SI = new SymbolicInterpreter(input);
+  if (getenv(kBatchEventsEnv) || getenv(kEventLogEnv)) {
+    event_buffer = new EventBuffer(SI);
+    if (getenv(kEventLogEnv) && !event_buffer->OpenLog(getenv(kEventLogEnv))) {
+      perror("Failed to open event log");
+    }
+  }
+
+  // Start the trace.
+  if (execution_fd >= 0) {
+    trace_fd = execution_fd;
+  } else {
+    trace_fd = open("szd_execution", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(trace_fd >= 0);
+  }
+  trace_writer = new TraceWriter();
 
-  pre_symbolic = 1;
+  __CrestPreSymbolic = 1;
 
   assert(!atexit(__CrestAtExit));
 }
 
 
 void __CrestAtExit() {
-  const SymbolicExecution& ex = SI->execution();
+  __CrestWriteTrace(true);
+  if (execution_fd < 0) {
+    close(trace_fd);
+  }
+}
+
+
+void __CrestWriteTrace(bool finish) {
+  if (event_buffer) {
+    event_buffer->Flush();
+  }
+  trace_writer->Append(SI->execution(), &trace_buff);
+  if (finish) {
+    trace_writer->Finish(&trace_buff);
+  }
+  num_unwritten_branches = 0;
+
+  size_t written = 0;
+  while (written < trace_buff.size()) {
+    ssize_t n = pwrite(trace_fd, trace_buff.data() + written,
+                       trace_buff.size() - written, trace_offset);
+    if (n <= 0)
+      break;
+    written += n;
+    trace_offset += n;
+  }
+  trace_buff.clear();
+}
+
+
+void __CrestForkServer() {
+  // Do not let any programs we run inherit fork-server mode.
+  unsetenv(kForkServerEnv);
+
+  // Tell run_crest that we are up.
+  int msg = 0;
+  if (write(kForkServerStatusFd, &msg, sizeof(msg)) != sizeof(msg)) {
+    // Not actually talking to run_crest -- just run normally.
+    return;
+  }
 
-  // Write the execution out to file 'szd_execution'.
-  string buff;
-  buff.reserve(1<<26);
-  ex.Serialize(&buff);
-  std::ofstream out("szd_execution", std::ios::out | std::ios::binary);
-  out.write(buff.data(), buff.size());
-  assert(!out.fail());
-  out.close();
+  while (read(kForkServerCtrlFd, &msg, sizeof(msg)) == sizeof(msg)) {
+    pid_t pid = fork();
+    if (pid < 0)
+      _exit(1);
+
+    if (pid == 0) {
+      // Child: run the program under test.
+      close(kForkServerCtrlFd);
+      close(kForkServerStatusFd);
+      return;
+    }
+
+    int status;
+    msg = pid;
+    if ((write(kForkServerStatusFd, &msg, sizeof(msg)) != sizeof(msg))
+        || (waitpid(pid, &status, 0) < 0)
+        || (write(kForkServerStatusFd, &status, sizeof(status)) != sizeof(status)))
+      _exit(1);
+  }
+
+  // run_crest has closed the pipe (or exited).
+  _exit(0);
 }
 
 
@@ -91,68 +207,124 @@ void __CrestAtExit() {
 //
 
 void __CrestLoad(__CREST_ID id, __CREST_ADDR addr, __CREST_VALUE val) {
-  if (!pre_symbolic)
+  if (__CrestPreSymbolic)
+    return;
+
+  if (event_buffer) {
+    event_buffer->Append(events::LOAD, 0, id, addr, val);
+  } else {
     SI->Load(id, addr, val);
+  }
 }
 
 
 void __CrestStore(__CREST_ID id, __CREST_ADDR addr) {
-  if (!pre_symbolic)
+  if (__CrestPreSymbolic)
+    return;
+
+  if (event_buffer) {
+    event_buffer->Append(events::STORE, 0, id, addr, 0);
+  } else {
     SI->Store(id, addr);
+  }
 }
 
 
 void __CrestClearStack(__CREST_ID id) {
-  if (!pre_symbolic)
+  if (__CrestPreSymbolic)
+    return;
+
+  if (event_buffer) {
+    event_buffer->Append(events::CLEAR_STACK, 0, id, 0, 0);
+  } else {
     SI->ClearStack(id);
+  }
 }
 
 
 void __CrestApply1(__CREST_ID id, __CREST_OP op, __CREST_VALUE val) {
   assert((op >= __CREST_NEGATE) && (op <= __CREST_L_NOT));
 
-  if (!pre_symbolic)
+  if (__CrestPreSymbolic)
+    return;
+
+  if (event_buffer) {
+    event_buffer->Append(events::APPLY_UNARY, kOpTable[op], id, 0, val);
+  } else {
     SI->ApplyUnaryOp(id, static_cast<unary_op_t>(kOpTable[op]), val);
+  }
 }
 
 
 void __CrestApply2(__CREST_ID id, __CREST_OP op, __CREST_VALUE val) {
   assert((op >= __CREST_ADD) && (op <= __CREST_CONCRETE));
 
-  if (pre_symbolic)
+  if (__CrestPreSymbolic)
     return;
 
   if ((op >= __CREST_ADD) && (op <= __CREST_L_OR)) {
-    SI->ApplyBinaryOp(id, static_cast<binary_op_t>(kOpTable[op]), val);
+    if (event_buffer) {
+      event_buffer->Append(events::APPLY_BINARY, kOpTable[op], id, 0, val);
+    } else {
+      SI->ApplyBinaryOp(id, static_cast<binary_op_t>(kOpTable[op]), val);
+    }
   } else {
-    SI->ApplyCompareOp(id, static_cast<compare_op_t>(kOpTable[op]), val);
+    if (event_buffer) {
+      event_buffer->Append(events::APPLY_COMPARE, kOpTable[op], id, 0, val);
+    } else {
+      SI->ApplyCompareOp(id, static_cast<compare_op_t>(kOpTable[op]), val);
+    }
   }
 }
 
 
 void __CrestBranch(__CREST_ID id, __CREST_BRANCH_ID bid, __CREST_BOOL b) {
-  if (pre_symbolic) {
-    // Precede the branch with a fake (concrete) load.
-    SI->Load(id, 0, b);
+  if (event_buffer) {
+    if (__CrestPreSymbolic) {
+      event_buffer->Append(events::LOAD, 0, id, 0, b);
+    }
+    event_buffer->Append(events::BRANCH, 0, id, bid, b);
+  } else {
+    if (__CrestPreSymbolic) {
+      // Precede the branch with a fake (concrete) load.
+      SI->Load(id, 0, b);
+    }
+    SI->Branch(id, bid, static_cast<bool>(b));
   }
 
-  SI->Branch(id, bid, static_cast<bool>(b));
+  if (++num_unwritten_branches == kTraceChunk) {
+    __CrestWriteTrace(false);
+  }
 }
 
 
 void __CrestCall(__CREST_ID id, __CREST_FUNCTION_ID fid) {
-  SI->Call(id, fid);
+  if (event_buffer) {
+    event_buffer->Append(events::CALL, 0, id, fid, 0);
+  } else {
+    SI->Call(id, fid);
+  }
 }
 
 
 void __CrestReturn(__CREST_ID id) {
-  SI->Return(id);
+  if (event_buffer) {
+    event_buffer->Append(events::RETURN, 0, id, 0, 0);
+  } else {
+    SI->Return(id);
+  }
 }
 
 
 void __CrestHandleReturn(__CREST_ID id, __CREST_VALUE val) {
-  if (!pre_symbolic)
+  if (__CrestPreSymbolic)
+    return;
+
+  if (event_buffer) {
+    event_buffer->Append(events::HANDLE_RETURN, 0, id, 0, val);
+  } else {
     SI->HandleReturn(id, val);
+  }
 }
 
 
@@ -160,32 +332,38 @@ void __CrestHandleReturn(__CREST_ID id, __CREST_VALUE val) {
 // Symbolic input functions.
 //
 
+static value_t __CrestNewInput(type_t type, addr_t addr) {
+  __CrestPreSymbolic = 0;
+  if (!event_buffer)
+    return SI->NewInput(type, addr);
+
+  // The input must be interpreted after all earlier events.
+  event_buffer->Flush();
+  value_t val = SI->NewInput(type, addr);
+  event_buffer->LogInput(type, addr, val);
+  return val;
+}
+
 void __CrestUChar(unsigned char* x) {
-  pre_symbolic = 0;
-  *x = (unsigned char)SI->NewInput(types::U_CHAR, (addr_t)x);
+  *x = (unsigned char)__CrestNewInput(types::U_CHAR, (addr_t)x);
 }
 
 void __CrestUShort(unsigned short* x) {
-  pre_symbolic = 0;
-  *x = (unsigned short)SI->NewInput(types::U_SHORT, (addr_t)x);
+  *x = (unsigned short)__CrestNewInput(types::U_SHORT, (addr_t)x);
 }
 
 void __CrestUInt(unsigned int* x) {
-  pre_symbolic = 0;
-  *x = (unsigned int)SI->NewInput(types::U_INT, (addr_t)x);
+  *x = (unsigned int)__CrestNewInput(types::U_INT, (addr_t)x);
 }
 
 void __CrestChar(char* x) {
-  pre_symbolic = 0;
-  *x = (char)SI->NewInput(types::CHAR, (addr_t)x);
+  *x = (char)__CrestNewInput(types::CHAR, (addr_t)x);
 }
 
 void __CrestShort(short* x) {
-  pre_symbolic = 0;
-  *x = (short)SI->NewInput(types::SHORT, (addr_t)x);
+  *x = (short)__CrestNewInput(types::SHORT, (addr_t)x);
 }
 
 void __CrestInt(int* x) {
-  pre_symbolic = 0;
-  *x = (int)SI->NewInput(types::INT, (addr_t)x);
+  *x = (int)__CrestNewInput(types::INT, (addr_t)x);
 }
@@ -184,6 +184,13 @@ EXTERN void __CrestCall(__CREST_ID, __CREST_FUNCTION_ID) __SKIP;
 EXTERN void __CrestReturn(__CREST_ID) __SKIP;
 EXTERN void __CrestHandleReturn(__CREST_ID, __CREST_VALUE) __SKIP;
 
+/*
+ * Non-zero until the program has read its first symbolic input.  Until
+ * then, Load, Store, ClearStack, Apply1, Apply2, and HandleReturn have
+ * no effect.  (See libcrest/crest_inline.h.)
+ */
+EXTERN int __CrestPreSymbolic;
+
 /*
  * Functions (macros) for obtaining symbolic inputs.
  */
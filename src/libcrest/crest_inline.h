@@ -0,0 +1,88 @@
+/* Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+ *
+ * This file is part of CREST, which is distributed under the revised
+ * BSD license.  A copy of this license can be found in the file LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+ * for details.
+ */
+
+#ifndef LIBCREST_CREST_INLINE_H__
+#define LIBCREST_CREST_INLINE_H__
+
+#include "crest.h"
+
+/*
+ * Inline variants of the instrumentation functions which have no effect
+ * until the program reads its first symbolic input.  Each tests
+ * __CrestPreSymbolic and only then calls the out-of-line function in
+ * libcrest, so instrumented code which runs before any symbolic input
+ * (e.g. initialization) pays only for a load and a test.
+ *
+ * When run with --crestInline, the CIL instrumentation calls these
+ * variants in every file which includes this header (e.g. by passing
+ * "-include crest_inline.h" to crestc), and the out-of-line functions
+ * in all other files.
+ *
+ * The variants are always inlined, even without optimization, and are
+ * marked "used" so that CIL does not remove them before instrumenting.
+ * These attributes (and crest_skip, so that the variants themselves are
+ * not instrumented) are given on separate prototypes, as with the
+ * declarations in crest.h: CIL attaches an unknown attribute at the
+ * start of a declaration to the return type, not to the function, and
+ * gcc does not accept attributes after the declarator of a definition.
+ */
+#define __CREST_INLINE static inline
+#define __CREST_INLINE_ATTRS \
+  __attribute__((always_inline, used, crest_skip))
+
+__CREST_INLINE void __CrestLoadInline(__CREST_ID, __CREST_ADDR,
+                                      __CREST_VALUE) __CREST_INLINE_ATTRS;
+__CREST_INLINE void __CrestStoreInline(__CREST_ID,
+                                       __CREST_ADDR) __CREST_INLINE_ATTRS;
+__CREST_INLINE void __CrestClearStackInline(__CREST_ID) __CREST_INLINE_ATTRS;
+__CREST_INLINE void __CrestApply1Inline(__CREST_ID, __CREST_OP,
+                                        __CREST_VALUE) __CREST_INLINE_ATTRS;
+__CREST_INLINE void __CrestApply2Inline(__CREST_ID, __CREST_OP,
+                                        __CREST_VALUE) __CREST_INLINE_ATTRS;
+__CREST_INLINE void __CrestHandleReturnInline(__CREST_ID,
+                                              __CREST_VALUE)
+  __CREST_INLINE_ATTRS;
+
+__CREST_INLINE void __CrestLoadInline(__CREST_ID id, __CREST_ADDR addr,
+                                      __CREST_VALUE val) {
+  if (!__CrestPreSymbolic)
+    __CrestLoad(id, addr, val);
+}
+
+__CREST_INLINE void __CrestStoreInline(__CREST_ID id, __CREST_ADDR addr) {
+  if (!__CrestPreSymbolic)
+    __CrestStore(id, addr);
+}
+
+__CREST_INLINE void __CrestClearStackInline(__CREST_ID id) {
+  if (!__CrestPreSymbolic)
+    __CrestClearStack(id);
+}
+
+__CREST_INLINE void __CrestApply1Inline(__CREST_ID id, __CREST_OP op,
+                                        __CREST_VALUE val) {
+  if (!__CrestPreSymbolic)
+    __CrestApply1(id, op, val);
+}
+
+__CREST_INLINE void __CrestApply2Inline(__CREST_ID id, __CREST_OP op,
+                                        __CREST_VALUE val) {
+  if (!__CrestPreSymbolic)
+    __CrestApply2(id, op, val);
+}
+
+__CREST_INLINE void __CrestHandleReturnInline(__CREST_ID id,
+                                              __CREST_VALUE val) {
+  if (!__CrestPreSymbolic)
+    __CrestHandleReturn(id, val);
+}
+
+#endif  /* LIBCREST_CREST_INLINE_H__ */
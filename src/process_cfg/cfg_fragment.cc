@@ -0,0 +1,356 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "process_cfg/cfg_fragment.h"
+
+using std::sort;
+
+namespace {
+
+const char kFragmentMagic[4] = { 'C', 'R', 'C', 'F' };
+const int kFragmentVersion = 1;
+
+const char kCacheMagic[4] = { 'C', 'R', 'C', 'C' };
+const int kCacheVersion = 1;
+
+bool readFile(const string& fname, string* s) {
+  FILE* f = fopen(fname.c_str(), "rb");
+  if (!f)
+    return false;
+  char buff[1 << 16];
+  size_t n;
+  while ((n = fread(buff, 1, sizeof(buff), f)) > 0) {
+    s->append(buff, n);
+  }
+  bool success = !ferror(f);
+  fclose(f);
+  return success;
+}
+
+// 64-bit FNV-1a.
+unsigned long long hashString(const string& s) {
+  unsigned long long h = 14695981039346656037ULL;
+  for (size_t i = 0; i < s.size(); i++) {
+    h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+// Reads the big-endian 32-bit integers written by OCaml's
+// output_binary_int.
+class FragmentReader {
+ public:
+  FragmentReader(const string& s) : p_(s.data()), end_(s.data() + s.size()) { }
+
+  bool ReadMagic() {
+    if (end_ - p_ < 4 || memcmp(p_, kFragmentMagic, 4))
+      return false;
+    p_ += 4;
+    return true;
+  }
+
+  bool ReadInt(int* x) {
+    if (end_ - p_ < 4)
+      return false;
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p_);
+    *x = (int)(((unsigned)u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3]);
+    p_ += 4;
+    return true;
+  }
+
+  bool ReadCount(size_t* n) {
+    int x;
+    if (!ReadInt(&x) || (x < 0) || ((end_ - p_) / 4 < x))
+      return false;
+    *n = x;
+    return true;
+  }
+
+  bool ReadInts(vector<int>* xs) {
+    size_t n;
+    if (!ReadCount(&n))
+      return false;
+    xs->resize(n);
+    for (size_t i = 0; i < n; i++) {
+      if (!ReadInt(&(*xs)[i]))
+        return false;
+    }
+    return true;
+  }
+
+  bool ReadString(string* s) {
+    int len;
+    if (!ReadInt(&len) || (len < 0) || (end_ - p_ < len))
+      return false;
+    s->assign(p_, len);
+    p_ += len;
+    return true;
+  }
+
+ private:
+  const char* p_;
+  const char* end_;
+};
+
+bool parseFragment(const string& s, cfg_fragment_t* frag) {
+  FragmentReader in(s);
+  int version;
+  size_t n;
+  if (!in.ReadMagic() || !in.ReadInt(&version)
+      || (version != kFragmentVersion) || !in.ReadCount(&n))
+    return false;
+
+  frag->names.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    if (!in.ReadString(&frag->names[i]))
+      return false;
+  }
+
+  if (!in.ReadCount(&n))
+    return false;
+  frag->funcs.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    cfg_func_t& f = frag->funcs[i];
+    int isStatic;
+    size_t m;
+    if (!in.ReadInt(&f.name) || (f.name < 0)
+        || ((size_t)f.name >= frag->names.size())
+        || !in.ReadInt(&isStatic) || !in.ReadInt(&f.fid)
+        || !in.ReadInt(&f.first) || !in.ReadCount(&m))
+      return false;
+    f.isStatic = isStatic;
+
+    f.branches.resize(m);
+    for (size_t j = 0; j < m; j++) {
+      if (!in.ReadInt(&f.branches[j].first)
+          || !in.ReadInt(&f.branches[j].second))
+        return false;
+    }
+
+    if (!in.ReadCount(&m))
+      return false;
+    f.nodes.resize(m);
+    for (size_t j = 0; j < m; j++) {
+      cfg_node_t& node = f.nodes[j];
+      if (!in.ReadInt(&node.sid) || !in.ReadInts(&node.succs)
+          || !in.ReadInts(&node.calls))
+        return false;
+      for (size_t k = 0; k < node.calls.size(); k++) {
+        if ((node.calls[k] < 0)
+            && ((size_t)(-1 - node.calls[k]) >= frag->names.size()))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+// The cache is written in native byte order, as it is only read back
+// by process_cfg on the same machine.
+
+void writeInt(FILE* f, int x) {
+  fwrite(&x, sizeof(x), 1, f);
+}
+
+void writeString(FILE* f, const string& s) {
+  writeInt(f, s.size());
+  fwrite(s.data(), 1, s.size(), f);
+}
+
+void writeInts(FILE* f, const vector<int>& xs) {
+  writeInt(f, xs.size());
+  if (!xs.empty())
+    fwrite(&xs.front(), sizeof(int), xs.size(), f);
+}
+
+void writeStrings(FILE* f, const vector<string>& ss) {
+  writeInt(f, ss.size());
+  for (size_t i = 0; i < ss.size(); i++) {
+    writeString(f, ss[i]);
+  }
+}
+
+bool readInt(FILE* f, int* x) {
+  return (fread(x, sizeof(*x), 1, f) == 1);
+}
+
+bool readCount(FILE* f, size_t* n) {
+  int x;
+  if (!readInt(f, &x) || (x < 0))
+    return false;
+  *n = x;
+  return true;
+}
+
+bool readInts(FILE* f, vector<int>* xs) {
+  size_t n;
+  if (!readCount(f, &n))
+    return false;
+  xs->resize(n);
+  return (n == 0) || (fread(&xs->front(), sizeof(int), n, f) == n);
+}
+
+bool readString(FILE* f, string* s) {
+  size_t len;
+  if (!readCount(f, &len))
+    return false;
+  s->resize(len);
+  return (len == 0) || (fread(&(*s)[0], 1, len, f) == len);
+}
+
+bool readStrings(FILE* f, vector<string>* ss) {
+  size_t n;
+  if (!readCount(f, &n))
+    return false;
+  ss->resize(n);
+  for (size_t i = 0; i < n; i++) {
+    if (!readString(f, &(*ss)[i]))
+      return false;
+  }
+  return true;
+}
+
+bool readCacheFuncs(FILE* f, cfg_cache_t* cache) {
+  size_t n;
+  if (!readStrings(f, &cache->files))
+    return false;
+  n = cache->files.size();
+  cache->hashes.resize(n);
+  if ((n > 0) && (fread(&cache->hashes.front(), sizeof(unsigned long long),
+                        n, f) != n))
+    return false;
+
+  if (!readCount(f, &n))
+    return false;
+  cache->funcs.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    cfg_cache_func_t& func = cache->funcs[i];
+    size_t m;
+    if (!readInt(f, &func.fragment) || !readString(f, &func.name)
+        || !readInts(f, &func.deps) || !readStrings(f, &func.undefined)
+        || !readCount(f, &m))
+      return false;
+    func.nbhrs.resize(m);
+    for (size_t j = 0; j < m; j++) {
+      if (!readInt(f, &func.nbhrs[j].first)
+          || !readInts(f, &func.nbhrs[j].second))
+        return false;
+    }
+
+    // Check the indices, so that they can be used without checks.
+    if ((func.fragment < 0) || ((size_t)func.fragment >= cache->files.size()))
+      return false;
+    for (size_t j = 0; j < func.deps.size(); j++) {
+      if ((func.deps[j] < 0) || ((size_t)func.deps[j] >= cache->files.size()))
+        return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+
+bool readCfgFragments(const char* dir, vector<cfg_fragment_t>* frags) {
+  DIR* d = opendir(dir);
+  if (!d)
+    return false;
+
+  vector<string> files;
+  struct dirent* ent;
+  while ((ent = readdir(d)) != NULL) {
+    if (ent->d_name[0] != '.')
+      files.push_back(string(dir) + "/" + ent->d_name);
+  }
+  closedir(d);
+  sort(files.begin(), files.end());
+
+  for (size_t i = 0; i < files.size(); i++) {
+    string contents;
+    struct stat st;
+    cfg_fragment_t frag;
+    if (stat(files[i].c_str(), &st) || !readFile(files[i], &contents)
+        || !parseFragment(contents, &frag)) {
+      fprintf(stderr, "Skipping unreadable CFG fragment %s.\n",
+              files[i].c_str());
+      continue;
+    }
+    frag.file = files[i];
+    frag.hash = hashString(contents);
+    frag.mtime = st.st_mtime;
+    frags->push_back(cfg_fragment_t());
+    frags->back().swap(frag);
+  }
+  return true;
+}
+
+
+bool readCfgCache(const char* fname, cfg_cache_t* cache) {
+  FILE* f = fopen(fname, "rb");
+  if (!f)
+    return false;
+
+  char magic[sizeof(kCacheMagic)];
+  int version;
+  bool success = (fread(magic, sizeof(magic), 1, f) == 1)
+    && !memcmp(magic, kCacheMagic, sizeof(magic))
+    && readInt(f, &version) && (version == kCacheVersion)
+    && readCacheFuncs(f, cache);
+  fclose(f);
+
+  if (!success) {
+    cache->files.clear();
+    cache->hashes.clear();
+    cache->funcs.clear();
+  }
+  return success;
+}
+
+
+bool writeCfgCache(const char* fname, const cfg_cache_t& cache) {
+  string tmp = string(fname) + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (!f)
+    return false;
+
+  fwrite(kCacheMagic, sizeof(kCacheMagic), 1, f);
+  writeInt(f, kCacheVersion);
+
+  writeStrings(f, cache.files);
+  if (!cache.hashes.empty()) {
+    fwrite(&cache.hashes.front(), sizeof(unsigned long long),
+           cache.hashes.size(), f);
+  }
+
+  writeInt(f, cache.funcs.size());
+  for (size_t i = 0; i < cache.funcs.size(); i++) {
+    const cfg_cache_func_t& func = cache.funcs[i];
+    writeInt(f, func.fragment);
+    writeString(f, func.name);
+    writeInts(f, func.deps);
+    writeStrings(f, func.undefined);
+    writeInt(f, func.nbhrs.size());
+    for (size_t j = 0; j < func.nbhrs.size(); j++) {
+      writeInt(f, func.nbhrs[j].first);
+      writeInts(f, func.nbhrs[j].second);
+    }
+  }
+
+  bool success = !ferror(f);
+  success = !fclose(f) && success;
+  return success && !rename(tmp.c_str(), fname);
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef PROCESS_CFG_CFG_FRAGMENT_H__
+#define PROCESS_CFG_CFG_FRAGMENT_H__
+
+#include <algorithm>
+#include <string>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::string;
+using std::vector;
+
+// The CFG fragment written by the instrumenter (crestInstrument.ml) for
+// one source file, in cfg_fragments/.  (See crestInstrument.ml for the
+// file format.)
+
+struct cfg_node_t {
+  int sid;
+  vector<int> succs;
+  // The first statement of a function in the same file, or
+  // -(1 + the index in cfg_fragment_t::names) of a function called by name.
+  vector<int> calls;
+};
+
+struct cfg_func_t {
+  int name;  // Index in cfg_fragment_t::names.
+  bool isStatic;
+  int fid;   // Zero if uninstrumented.
+  int first;
+  vector< pair<int,int> > branches;
+  vector<cfg_node_t> nodes;
+};
+
+struct cfg_fragment_t {
+  string file;
+  unsigned long long hash;  // Of the file's contents.
+  time_t mtime;
+  vector<string> names;
+  vector<cfg_func_t> funcs;
+
+  void swap(cfg_fragment_t& other) {
+    file.swap(other.file);
+    std::swap(hash, other.hash);
+    std::swap(mtime, other.mtime);
+    names.swap(other.names);
+    funcs.swap(other.funcs);
+  }
+};
+
+// Reads all of the fragments in directory 'dir', in order of file name.
+// Returns false if there is no such directory.  (Unreadable fragments
+// are skipped with a warning.)
+bool readCfgFragments(const char* dir, vector<cfg_fragment_t>* frags);
+
+
+// The results of an earlier run of process_cfg, so that a run can
+// recompute only the results which depend on fragments that changed.
+//
+// For each function, the cache holds the branches distance one from each
+// of its branches, along with what those results depend on: the
+// fragments whose nodes were visited, and the functions which were
+// called but not defined (and so could be defined by a new fragment).
+
+struct cfg_cache_func_t {
+  int fragment;  // Index in cfg_cache_t::files.
+  string name;
+  vector<int> deps;  // Indices in cfg_cache_t::files.
+  vector<string> undefined;
+  vector< pair< int, vector<int> > > nbhrs;
+};
+
+struct cfg_cache_t {
+  vector<string> files;  // The fragments, with the hashes of their contents.
+  vector<unsigned long long> hashes;
+  vector<cfg_cache_func_t> funcs;
+};
+
+// Returns false (leaving *cache empty) if there is no valid cache.
+bool readCfgCache(const char* fname, cfg_cache_t* cache);
+bool writeCfgCache(const char* fname, const cfg_cache_t& cache);
+
+#endif  // PROCESS_CFG_CFG_FRAGMENT_H__
@@ -12,22 +12,24 @@
 #include <assert.h>
 #include <ctype.h>
 #include <fstream>
+#include <functional>
 #include <limits>
+#include <map>
+#include <pthread.h>
+#include <queue>
 #include <set>
-#include <sstream>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
+#include <unistd.h>
 #include <vector>
 #include <ext/hash_map>
 
+#include "process_cfg/cfg_fragment.h"
+
 using namespace std;
 using __gnu_cxx::hash_map;
 
-typedef pair<int,int> edge_t;
-typedef vector< pair<int,size_t> > adj_list_t;
-typedef adj_list_t::iterator nbhr_it;
-typedef adj_list_t::const_iterator const_nbhr_it;
-typedef vector<adj_list_t> graph_t;
 typedef set<int>::const_iterator BranchIt;
 
 namespace __gnu_cxx {
@@ -38,6 +40,39 @@ namespace __gnu_cxx {
   };
 }
 
+static const char kFragmentDir[] = "cfg_fragments";
+static const char kCacheFile[] = "cfg_cache";
+
+// The CFG, in compressed sparse row form: the successors of node v are
+// dsts[offsets[v]] ... dsts[offsets[v+1] - 1].
+struct csr_graph_t {
+  vector<size_t> offsets;
+  vector<int> dsts;
+
+  size_t size() const { return offsets.size() - 1; }
+};
+
+// Builds the CSR arrays, preserving the order of each node's edges.
+void buildCsr(int numNodes, const vector< pair<int,int> >& edges,
+              csr_graph_t* graph) {
+  graph->offsets.assign(numNodes + 1, 0);
+  for (size_t i = 0; i < edges.size(); i++) {
+    graph->offsets[edges[i].first + 1]++;
+  }
+  for (int v = 0; v < numNodes; v++) {
+    graph->offsets[v + 1] += graph->offsets[v];
+  }
+  graph->dsts.resize(edges.size());
+  vector<size_t> next(graph->offsets.begin(), graph->offsets.end() - 1);
+  for (size_t i = 0; i < edges.size(); i++) {
+    graph->dsts[next[edges[i].first]++] = edges[i].second;
+  }
+}
+
+
+// Without CFG fragments, the CFG and branches are read from the text
+// files "cfg", "cfg_func_map", and "branches".
+
 void readBranches(set<int>* branches) {
   ifstream in("branches");
 
@@ -54,7 +89,20 @@ void readBranches(set<int>* branches) {
   in.close();
 }
 
-void readCfg(graph_t* graph) {
+// Reads the whole of file 'fname' into *s.
+void readFile(const char* fname, string* s) {
+  FILE* f = fopen(fname, "rb");
+  if (!f)
+    return;
+  char buff[1 << 16];
+  size_t n;
+  while ((n = fread(buff, 1, sizeof(buff), f)) > 0) {
+    s->append(buff, n);
+  }
+  fclose(f);
+}
+
+void readCfg(csr_graph_t* graph) {
   // First we have to read in the function -> CFG node map.
   hash_map<string,int> funcNodeMap;
   { ifstream in("cfg_func_map");
@@ -67,137 +115,777 @@ void readCfg(graph_t* graph) {
   }
 
   // No we can read in the CFG edges, substituting the correct CFG nodes
-  // for function calls.
-  ifstream in("cfg");
-
-  string line;
-  while (getline(in, line)) {
-    istringstream line_in(line);
-    int src;
-    line_in >> src;
-    line_in.get();
-
-    if (graph->size() <= src)
-      graph->resize(src+1);
-    adj_list_t& nbhrs = (*graph)[src];
-
-    while (line_in) {
-      if (isdigit(line_in.peek())) {
-	int dst;
-	line_in >> dst;
-	nbhrs.push_back(make_pair(dst, 0));
+  // for function calls.  Each line is a node, followed by its successors
+  // and the functions it calls, separated by single spaces.
+  string cfg;
+  readFile("cfg", &cfg);
+
+  vector< pair<int,int> > edges;
+  int numNodes = 0;
+  const char* p = cfg.c_str();
+  const char* end = p + cfg.size();
+  string func;
+  while (p < end) {
+    char* q;
+    int src = strtol(p, &q, 10);
+    if (q == p) {
+      // Skip a malformed line.
+      while ((p < end) && (*p != '\n')) p++;
+      p++;
+      continue;
+    }
+    p = q;
+    numNodes = max(numNodes, src + 1);
+
+    while ((p < end) && (*p == ' ')) {
+      p++;
+      if (isdigit(*p)) {
+        int dst = strtol(p, &q, 10);
+        p = q;
+        edges.push_back(make_pair(src, dst));
+        numNodes = max(numNodes, dst + 1);
       } else {
-	string func;
-	line_in >> func;
-	hash_map<string,int>::iterator it = funcNodeMap.find(func);
-	if (it != funcNodeMap.end())
-	  nbhrs.push_back(make_pair(it->second,0));
+        const char* name = p;
+        while ((p < end) && (*p != ' ') && (*p != '\n')) p++;
+        func.assign(name, p - name);
+        hash_map<string,int>::iterator it = funcNodeMap.find(func);
+        if (it != funcNodeMap.end()) {
+          edges.push_back(make_pair(src, it->second));
+          numNodes = max(numNodes, it->second + 1);
+        }
       }
-      line_in.get();
     }
+    // Skip the rest of the line.
+    while ((p < end) && (*p != '\n')) p++;
+    p++;
   }
 
-  in.close();
+  buildCsr(numNodes, edges, graph);
 }
 
-void dijkstra_bounded_shortest_paths
-(const graph_t& g, int src, vector<size_t>& dist_map, size_t max_dist) {
 
-  // Initialize all distances.
-  for (int i = 0; i < g.size(); i++) {
-    dist_map[i] = numeric_limits<size_t>::max();
+// The program, as merged from the CFG fragments.
+struct program_t {
+  vector<cfg_fragment_t> frags;
+  // Each function, as its fragment and its index in that fragment.
+  vector< pair<int,int> > funcs;
+  // The first CFG node of each non-static function.
+  hash_map<string,int> funcNodeMap;
+  // The fragment of each CFG node, or -1.
+  vector<int> owner;
+  // The names called from each CFG node which no fragment defines.
+  vector<char> hasUndefined;
+  hash_map< int, vector<string> > undefined;
+
+  const cfg_fragment_t& frag(size_t i) const { return frags[funcs[i].first]; }
+  const cfg_func_t& func(size_t i) const {
+    return frags[funcs[i].first].funcs[funcs[i].second];
   }
-  dist_map[src] = 0;
+};
 
-  // Initialize the queue.
-  set< pair<size_t, int> > Q;
-  Q.insert(make_pair(0, src));
+// Drops every fragment which defines a non-static function also defined
+// by a newer fragment (e.g. the leftover fragment of a source file that
+// was since renamed).
+void dropStaleFragments(vector<cfg_fragment_t>* frags) {
+  vector<char> stale(frags->size(), 0);
+  hash_map<string,int> definer;
+  for (size_t i = 0; i < frags->size(); i++) {
+    const cfg_fragment_t& frag = (*frags)[i];
+    for (size_t j = 0; j < frag.funcs.size(); j++) {
+      if (frag.funcs[j].isStatic)
+        continue;
+      const string& name = frag.names[frag.funcs[j].name];
+      hash_map<string,int>::iterator it = definer.find(name);
+      if (it == definer.end()) {
+        definer[name] = i;
+      } else if ((*frags)[it->second].mtime <= frag.mtime) {
+        stale[it->second] = 1;
+        it->second = i;
+      } else {
+        stale[i] = 1;
+      }
+    }
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < frags->size(); i++) {
+    if (stale[i]) {
+      fprintf(stderr, "Ignoring stale CFG fragment %s.\n",
+              (*frags)[i].file.c_str());
+    } else {
+      (*frags)[n++].swap((*frags)[i]);
+    }
+  }
+  frags->resize(n);
+}
+
+// Merges the fragments into one CFG, resolving calls by name.
+void mergeFragments(program_t* prog, csr_graph_t* graph, set<int>* branches) {
+  for (size_t i = 0; i < prog->frags.size(); i++) {
+    const cfg_fragment_t& frag = prog->frags[i];
+    for (size_t j = 0; j < frag.funcs.size(); j++) {
+      prog->funcs.push_back(make_pair(i, j));
+      if (!frag.funcs[j].isStatic)
+        prog->funcNodeMap[frag.names[frag.funcs[j].name]] = frag.funcs[j].first;
+    }
+  }
+
+  vector< pair<int,int> > edges;
+  vector< pair<int,int> > owners;
+  int numNodes = 0;
+  for (size_t i = 0; i < prog->funcs.size(); i++) {
+    const cfg_fragment_t& frag = prog->frag(i);
+    const cfg_func_t& f = prog->func(i);
+    for (size_t j = 0; j < f.branches.size(); j++) {
+      branches->insert(f.branches[j].first);
+      branches->insert(f.branches[j].second);
+    }
+
+    for (size_t j = 0; j < f.nodes.size(); j++) {
+      const cfg_node_t& node = f.nodes[j];
+      if (node.sid < 0)
+        continue;
+      owners.push_back(make_pair(node.sid, prog->funcs[i].first));
+      numNodes = max(numNodes, node.sid + 1);
+
+      for (size_t k = 0; k < node.succs.size(); k++) {
+        edges.push_back(make_pair(node.sid, node.succs[k]));
+        numNodes = max(numNodes, node.succs[k] + 1);
+      }
+      for (size_t k = 0; k < node.calls.size(); k++) {
+        int dst = node.calls[k];
+        if (dst < 0) {
+          const string& name = frag.names[-1 - dst];
+          hash_map<string,int>::iterator it = prog->funcNodeMap.find(name);
+          if (it == prog->funcNodeMap.end()) {
+            prog->undefined[node.sid].push_back(name);
+            continue;
+          }
+          dst = it->second;
+        }
+        edges.push_back(make_pair(node.sid, dst));
+        numNodes = max(numNodes, dst + 1);
+      }
+    }
+  }
 
-  // Initialize the sets of seen and finished vertices.
-  set<int> finished;
+  buildCsr(numNodes, edges, graph);
+
+  prog->owner.assign(numNodes, -1);
+  for (size_t i = 0; i < owners.size(); i++) {
+    prog->owner[owners[i].first] = owners[i].second;
+  }
+  prog->hasUndefined.assign(numNodes, 0);
+  for (hash_map< int, vector<string> >::iterator it = prog->undefined.begin();
+       it != prog->undefined.end(); ++it) {
+    prog->hasUndefined[it->first] = 1;
+  }
+}
+
+// Writes the "branches" file read by run_crest, in which the i-th line
+// pair list is for function i.  (Functions with no fragment -- e.g.
+// from an earlier instrumentation of a file -- get empty lists.)
+void writeBranches(const program_t& prog) {
+  vector<const cfg_func_t*> byFid;
+  for (size_t i = 0; i < prog.funcs.size(); i++) {
+    const cfg_func_t& f = prog.func(i);
+    if (f.fid <= 0)
+      continue;
+    if ((size_t)f.fid >= byFid.size())
+      byFid.resize(f.fid + 1, NULL);
+    byFid[f.fid] = &f;
+  }
+
+  FILE* out = fopen("branches", "w");
+  if (!out) {
+    perror("Failed to write branches");
+    exit(-1);
+  }
+  for (size_t fid = 1; fid < byFid.size(); fid++) {
+    const cfg_func_t* f = byFid[fid];
+    fprintf(out, "%d %d\n", (int)fid, f ? (int)f->branches.size() : 0);
+    for (size_t j = 0; f && (j < f->branches.size()); j++) {
+      fprintf(out, "%d %d\n", f->branches[j].first, f->branches[j].second);
+    }
+  }
+  fclose(out);
+}
+
+// Function summaries, for the call-aware distances of run_crest's cfg
+// search: for each branch, the fewest branches passed on the way from it
+// to the return of its function (counting calls -- see below).
+//
+// Within a function these are shortest paths, found with a Dijkstra
+// search backwards from the returns (the statements without successors),
+// in which reaching a branch costs one and a call costs the callee's
+// entry-to-exit summary: the fewest branches on any path through it.
+// Callees are summarized before their callers, by visiting the strongly
+// connected components of the call graph in reverse topological order
+// and iterating to a fixed point within each recursive component.
+// (Calls to functions without fragments cost nothing.)
+
+static const char kSummaryFile[] = "cfg_summaries";
+static const int kNoExit = numeric_limits<int>::max();
+
+int addDists(int a, int b) {
+  return ((a == kNoExit) || (b == kNoExit) || (a + b < a)) ? kNoExit : a + b;
+}
+
+// Returns the indices in prog.funcs of the functions called from each
+// CFG node of function 'f' (parallel to its nodes), given the function
+// whose first CFG node is each node.
+void findCallees(const program_t& prog, size_t f,
+                 const hash_map<int,int>& entryFunc,
+                 vector< vector<int> >* callees) {
+  const cfg_fragment_t& frag = prog.frag(f);
+  const vector<cfg_node_t>& nodes = prog.func(f).nodes;
+  callees->assign(nodes.size(), vector<int>());
+  for (size_t i = 0; i < nodes.size(); i++) {
+    for (size_t j = 0; j < nodes[i].calls.size(); j++) {
+      int dst = nodes[i].calls[j];
+      if (dst < 0) {
+        hash_map<string,int>::const_iterator it =
+          prog.funcNodeMap.find(frag.names[-1 - dst]);
+        if (it == prog.funcNodeMap.end())
+          continue;
+        dst = it->second;
+      }
+      hash_map<int,int>::const_iterator it = entryFunc.find(dst);
+      if (it != entryFunc.end())
+        (*callees)[i].push_back(it->second);
+    }
+  }
+}
+
+// Computes the distance from each CFG node of function 'f' to its return
+// (storing those of its branches in *exitDist), given the entry-to-exit
+// summaries of the functions it calls.  Returns the summary of 'f'.
+int summarizeFunction(const program_t& prog, size_t f,
+                      const vector< vector<int> >& callees,
+                      const vector<int>& entryExit,
+                      const vector<char>& isBranch,
+                      vector<int>* local, vector<int>* exitDist) {
+  const cfg_func_t& func = prog.func(f);
+  const vector<cfg_node_t>& nodes = func.nodes;
+  const int n = nodes.size();
+
+  for (int i = 0; i < n; i++) {
+    (*local)[nodes[i].sid] = i;
+  }
+
+  vector<int> callCost(n, 0);
+  vector< vector<int> > preds(n);
+  vector<int> dist(n, kNoExit);
+  typedef pair<int,int> entry_t;
+  priority_queue<entry_t, vector<entry_t>, greater<entry_t> > Q;
+  for (int i = 0; i < n; i++) {
+    for (size_t j = 0; j < callees[i].size(); j++) {
+      callCost[i] = addDists(callCost[i], entryExit[callees[i][j]]);
+    }
+    for (size_t j = 0; j < nodes[i].succs.size(); j++) {
+      int succ = nodes[i].succs[j];
+      if ((succ >= 0) && ((size_t)succ < local->size())
+          && ((*local)[succ] >= 0))
+        preds[(*local)[succ]].push_back(i);
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    if (nodes[i].succs.empty() && (callCost[i] != kNoExit)) {
+      dist[i] = callCost[i];
+      Q.push(make_pair(dist[i], i));
+    }
+  }
 
   while (!Q.empty()) {
-    // Pop the head of the queue.
-    int v = Q.begin()->second;
-    size_t dist = Q.begin()->first;
-    Q.erase(Q.begin());
-
-    // If the current distance is greater than the max, we're done.
-    if (dist > max_dist)
-      break;
-
-    // Otherwise, process the vertex.
-    finished.insert(v);
-    for (const_nbhr_it e = g[v].begin(); e != g[v].end(); ++e) {
-      int u = e->first;
-      if (finished.find(u) == finished.end()) {
-        size_t d = dist_map[v] + e->second;
-        if ((d < dist_map[u]) && (d <= max_dist)) {
-          Q.erase(make_pair(dist_map[u], u));
-          Q.insert(make_pair(d, u));
-          dist_map[u] = d;
+    int d = Q.top().first;
+    int u = Q.top().second;
+    Q.pop();
+    if (d != dist[u])
+      continue;
+    int du = addDists(d, isBranch[nodes[u].sid]);
+    for (size_t j = 0; j < preds[u].size(); j++) {
+      int v = preds[u][j];
+      int dv = addDists(callCost[v], du);
+      if (dv < dist[v]) {
+        dist[v] = dv;
+        Q.push(make_pair(dv, v));
+      }
+    }
+  }
+
+  int summary = kNoExit;
+  for (int i = 0; i < n; i++) {
+    if (isBranch[nodes[i].sid])
+      (*exitDist)[nodes[i].sid] = dist[i];
+    if (nodes[i].sid == func.first)
+      summary = addDists(dist[i], isBranch[nodes[i].sid]);
+    (*local)[nodes[i].sid] = -1;
+  }
+  return summary;
+}
+
+// Computes the exit distances of all branches (kNoExit for a branch
+// from which its function cannot return).
+void computeSummaries(const program_t& prog, const vector<char>& isBranch,
+                      vector<int>* exitDist) {
+  const size_t nf = prog.funcs.size();
+  exitDist->assign(isBranch.size(), kNoExit);
+
+  hash_map<int,int> entryFunc;
+  for (size_t f = 0; f < nf; f++) {
+    entryFunc[prog.func(f).first] = f;
+  }
+  vector< vector< vector<int> > > callees(nf);
+  vector< vector<int> > callGraph(nf);
+  for (size_t f = 0; f < nf; f++) {
+    findCallees(prog, f, entryFunc, &callees[f]);
+    for (size_t i = 0; i < callees[f].size(); i++) {
+      callGraph[f].insert(callGraph[f].end(),
+                          callees[f][i].begin(), callees[f][i].end());
+    }
+  }
+
+  // Tarjan's algorithm, with an explicit stack, which finishes each
+  // component after all of the components it calls.
+  vector<int> index(nf, -1), lowlink(nf, 0);
+  vector<char> onStack(nf, 0);
+  vector<int> stack;
+  vector< pair<int,size_t> > dfs;
+  vector< vector<int> > comps;
+  int nextIndex = 0;
+  for (size_t root = 0; root < nf; root++) {
+    if (index[root] >= 0)
+      continue;
+    dfs.push_back(make_pair((int)root, (size_t)0));
+    index[root] = lowlink[root] = nextIndex++;
+    stack.push_back(root);
+    onStack[root] = 1;
+    while (!dfs.empty()) {
+      int f = dfs.back().first;
+      size_t& e = dfs.back().second;
+      if (e < callGraph[f].size()) {
+        int g = callGraph[f][e++];
+        if (index[g] < 0) {
+          index[g] = lowlink[g] = nextIndex++;
+          stack.push_back(g);
+          onStack[g] = 1;
+          dfs.push_back(make_pair(g, (size_t)0));
+        } else if (onStack[g]) {
+          lowlink[f] = min(lowlink[f], index[g]);
         }
+        continue;
+      }
+      dfs.pop_back();
+      if (!dfs.empty())
+        lowlink[dfs.back().first] = min(lowlink[dfs.back().first], lowlink[f]);
+      if (lowlink[f] == index[f]) {
+        comps.push_back(vector<int>());
+        int g;
+        do {
+          g = stack.back();
+          stack.pop_back();
+          onStack[g] = 0;
+          comps.back().push_back(g);
+        } while (g != f);
       }
     }
   }
+
+  vector<int> entryExit(nf, kNoExit);
+  vector<int> local(isBranch.size(), -1);
+  for (size_t c = 0; c < comps.size(); c++) {
+    const vector<int>& comp = comps[c];
+    bool recursive = (comp.size() > 1)
+      || (find(callGraph[comp[0]].begin(), callGraph[comp[0]].end(), comp[0])
+          != callGraph[comp[0]].end());
+    bool changed;
+    do {
+      changed = false;
+      for (size_t i = 0; i < comp.size(); i++) {
+        int f = comp[i];
+        int summary = summarizeFunction(prog, f, callees[f], entryExit,
+                                        isBranch, &local, exitDist);
+        if (summary < entryExit[f]) {
+          entryExit[f] = summary;
+          changed = true;
+        }
+      }
+    } while (recursive && changed);
+  }
+}
+
+// Writes the exit distance of each branch (-1 for none), in the same
+// binary layout as cfg_branches.
+void writeSummaries(const vector<int>& branches, const vector<int>& exitDist) {
+  std::ofstream out(kSummaryFile, std::ios::out | std::ios::binary);
+  size_t len = branches.size();
+  out.write((char*)&len, sizeof(len));
+  for (size_t i = 0; i < branches.size(); i++) {
+    int b = branches[i];
+    int d = ((b >= 0) && ((size_t)b < exitDist.size())) ? exitDist[b] : kNoExit;
+    if (d == kNoExit)
+      d = -1;
+    out.write((char*)&b, sizeof(b));
+    out.write((char*)&d, sizeof(d));
+  }
+  out.close();
 }
 
 
-int main(void) {
+// The per-thread state for finding the branches a distance one from
+// each of a set of branches.
+struct worker_t {
+  const csr_graph_t* cfg;
+  const vector<char>* isBranch;
+  const vector<int>* branches;
+  const vector<int>* todo;  // Indices into branches.
+  size_t first, stride;  // Handle todo[first], [first + stride], ...
+  vector< vector<int> >* nbhrs;
+
+  // With fragments, the fragments visited and the nodes with undefined
+  // calls expanded by each search are recorded, for the cache.
+  const program_t* prog;
+  vector< vector<int> >* deps;
+  vector< vector<int> >* undefs;
+
+  vector<unsigned char> dist;  // 2 for unvisited.
+  vector<int> touched;
+  vector<int> queue;
+};
 
-  // Read in the set of branches.
-  set<int> branches;
-  readBranches(&branches);
-  fprintf(stderr, "Read %d branches.\n", branches.size());
+// Finds the branches at distance exactly one from branch 'src', where
+// an edge has length one if its destination is a branch and zero
+// otherwise, with a 0-1 BFS.  The results go in *nbhrs, sorted.
+//
+// Every edge into a branch has length one, so (apart from 'src') each
+// branch is at distance one or more, and nothing beyond a distance-one
+// node can be another distance-one branch: the search stops there.
+// Only the nodes actually visited are reset afterwards.
+//
+// If 'deps' is non-NULL, the fragments of the visited nodes go in *deps
+// and the expanded nodes with undefined calls in *undefs.
+void findBranchNbhrs(worker_t* w, int src, vector<int>* nbhrs,
+                     vector<int>* deps, vector<int>* undefs) {
+  const csr_graph_t& g = *w->cfg;
+  const vector<char>& isBranch = *w->isBranch;
+  vector<unsigned char>& dist = w->dist;
+
+  nbhrs->clear();
+  if (src < 0 || (size_t)src >= g.size())
+    return;
 
-  // Read in the CFG.
-  graph_t cfg;
-  cfg.reserve(1000000);
-  readCfg(&cfg);
-  fprintf(stderr, "Read %d nodes.\n", cfg.size());
+  // The queue holds the distance-zero frontier (as a stack -- the order
+  // within one distance does not matter).
+  vector<int>& touched = w->touched;
+  vector<int>& Q = w->queue;
+  dist[src] = 0;
+  touched.push_back(src);
+  Q.push_back(src);
 
-  // Set the length of every edge to 1 if the destination is a branch,
-  // and zero otherwise.
-  for (size_t i = 0; i < cfg.size(); i++) {
-    for (nbhr_it j = cfg[i].begin(); j != cfg[i].end(); ++j) {
-      if (branches.find(j->first) != branches.end()) {
-	j->second = 1;
+  while (!Q.empty()) {
+    int v = Q.back();
+    Q.pop_back();
+    if (undefs && w->prog->hasUndefined[v])
+      undefs->push_back(v);
+    for (size_t e = g.offsets[v]; e < g.offsets[v+1]; e++) {
+      int u = g.dsts[e];
+      if ((size_t)u >= g.size() || (dist[u] != 2))
+        continue;
+      touched.push_back(u);
+      if (isBranch[u]) {
+        dist[u] = 1;
+        nbhrs->push_back(u);
       } else {
-	j->second = 0;
+        dist[u] = 0;
+        Q.push_back(u);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < touched.size(); i++) {
+    dist[touched[i]] = 2;
+  }
+  if (deps) {
+    // A fragment's nodes are mostly numbered consecutively, so skipping
+    // repeats of the last fragment removes most duplicates.
+    const vector<int>& owner = w->prog->owner;
+    for (size_t i = 0; i < touched.size(); i++) {
+      int frag = owner[touched[i]];
+      if ((frag >= 0) && (deps->empty() || (deps->back() != frag)))
+        deps->push_back(frag);
+    }
+    sort(deps->begin(), deps->end());
+    deps->erase(unique(deps->begin(), deps->end()), deps->end());
+  }
+  touched.clear();
+  sort(nbhrs->begin(), nbhrs->end());
+}
+
+void* runWorker(void* arg) {
+  worker_t* w = static_cast<worker_t*>(arg);
+  w->dist.assign(w->cfg->size(), 2);
+  for (size_t i = w->first; i < w->todo->size(); i += w->stride) {
+    size_t b = (*w->todo)[i];
+    if (w->prog) {
+      findBranchNbhrs(w, (*w->branches)[b], &(*w->nbhrs)[b],
+                      &(*w->deps)[b], &(*w->undefs)[b]);
+    } else {
+      findBranchNbhrs(w, (*w->branches)[b], &(*w->nbhrs)[b], NULL, NULL);
+    }
+  }
+  return NULL;
+}
+
+
+// Returns the index of branch 'b' in the sorted 'branches'.
+size_t branchIndex(const vector<int>& branches, int b) {
+  return lower_bound(branches.begin(), branches.end(), b) - branches.begin();
+}
+
+// Finds the index in 'cache.files' of each fragment, or -1, and sets
+// (*unchanged)[i] if fragment i of the cache is unchanged.
+void matchCachedFragments(const program_t& prog, const cfg_cache_t& cache,
+                          vector<int>* cacheIdx, vector<char>* unchanged) {
+  map<string,int> files;
+  for (size_t i = 0; i < cache.files.size(); i++) {
+    files[cache.files[i]] = i;
+  }
+  cacheIdx->assign(prog.frags.size(), -1);
+  unchanged->assign(cache.files.size(), 0);
+  for (size_t i = 0; i < prog.frags.size(); i++) {
+    map<string,int>::iterator it = files.find(prog.frags[i].file);
+    if (it == files.end())
+      continue;
+    (*cacheIdx)[i] = it->second;
+    (*unchanged)[it->second] = (cache.hashes[it->second] == prog.frags[i].hash);
+  }
+}
+
+// Copies the cached results for each function which cannot have changed:
+// its fragment and every fragment its searches visited are unchanged,
+// and no function it called but which was not defined is now defined.
+// Sets (*reused)[i] to the cache entry of function i, or -1.
+void reuseCachedResults(const program_t& prog, const cfg_cache_t& cache,
+                        const vector<int>& branches, vector<int>* reused,
+                        vector< vector<int> >* nbhrs, vector<char>* done) {
+  vector<int> cacheIdx;
+  vector<char> unchanged;
+  matchCachedFragments(prog, cache, &cacheIdx, &unchanged);
+  map< pair<int,string>, int > index;
+  for (size_t i = 0; i < cache.funcs.size(); i++) {
+    index[make_pair(cache.funcs[i].fragment, cache.funcs[i].name)] = i;
+  }
+
+  reused->assign(prog.funcs.size(), -1);
+  for (size_t i = 0; i < prog.funcs.size(); i++) {
+    int frag = cacheIdx[prog.funcs[i].first];
+    if ((frag < 0) || !unchanged[frag])
+      continue;
+    map< pair<int,string>, int >::iterator it =
+      index.find(make_pair(frag, prog.frag(i).names[prog.func(i).name]));
+    if (it == index.end())
+      continue;
+
+    const cfg_cache_func_t& entry = cache.funcs[it->second];
+    bool valid = true;
+    for (size_t j = 0; valid && (j < entry.deps.size()); j++) {
+      valid = unchanged[entry.deps[j]];
+    }
+    for (size_t j = 0; valid && (j < entry.undefined.size()); j++) {
+      valid = (prog.funcNodeMap.find(entry.undefined[j])
+               == prog.funcNodeMap.end());
+    }
+    for (size_t j = 0; valid && (j < entry.nbhrs.size()); j++) {
+      size_t k = branchIndex(branches, entry.nbhrs[j].first);
+      valid = (k < branches.size()) && (branches[k] == entry.nbhrs[j].first);
+    }
+    if (!valid)
+      continue;
+
+    (*reused)[i] = it->second;
+    for (size_t j = 0; j < entry.nbhrs.size(); j++) {
+      size_t k = branchIndex(branches, entry.nbhrs[j].first);
+      (*nbhrs)[k] = entry.nbhrs[j].second;
+      (*done)[k] = 1;
+    }
+  }
+}
+
+// Builds the new cache from the reused and the recomputed results.  The
+// cache's fragments are exactly the current ones, in the same order.
+void buildCache(const program_t& prog, const vector<int>& branches,
+                const vector< vector<int> >& nbhrs,
+                const vector< vector<int> >& deps,
+                const vector< vector<int> >& undefs,
+                const cfg_cache_t& oldCache, const vector<int>& reused,
+                cfg_cache_t* cache) {
+  for (size_t i = 0; i < prog.frags.size(); i++) {
+    cache->files.push_back(prog.frags[i].file);
+    cache->hashes.push_back(prog.frags[i].hash);
+  }
+
+  // Renumbers the fragments of the reused entries, all of which are
+  // current.
+  vector<int> cacheIdx;
+  vector<char> unchanged;
+  matchCachedFragments(prog, oldCache, &cacheIdx, &unchanged);
+  vector<int> renumber(oldCache.files.size(), -1);
+  for (size_t i = 0; i < cacheIdx.size(); i++) {
+    if (cacheIdx[i] >= 0)
+      renumber[cacheIdx[i]] = i;
+  }
+
+  cache->funcs.resize(prog.funcs.size());
+  for (size_t i = 0; i < prog.funcs.size(); i++) {
+    cfg_cache_func_t& entry = cache->funcs[i];
+    if (reused[i] >= 0) {
+      entry = oldCache.funcs[reused[i]];
+      entry.fragment = renumber[entry.fragment];
+      for (size_t j = 0; j < entry.deps.size(); j++) {
+        entry.deps[j] = renumber[entry.deps[j]];
+      }
+      continue;
+    }
+
+    const cfg_func_t& f = prog.func(i);
+    entry.fragment = prog.funcs[i].first;
+    entry.name = prog.frag(i).names[f.name];
+
+    set<int> depSet;
+    set<string> undefSet;
+    for (size_t j = 0; j < 2 * f.branches.size(); j++) {
+      int b = (j % 2) ? f.branches[j/2].second : f.branches[j/2].first;
+      size_t k = branchIndex(branches, b);
+      entry.nbhrs.push_back(make_pair(b, nbhrs[k]));
+      depSet.insert(deps[k].begin(), deps[k].end());
+      for (size_t m = 0; m < undefs[k].size(); m++) {
+        const vector<string>& names =
+          prog.undefined.find(undefs[k][m])->second;
+        undefSet.insert(names.begin(), names.end());
       }
     }
+    entry.deps.assign(depSet.begin(), depSet.end());
+    entry.undefined.assign(undefSet.begin(), undefSet.end());
+  }
+}
+
+
+int main(int argc, char* argv[]) {
+  // The number of threads defaults to the number of processors.
+  int numThreads = (argc > 1) ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (numThreads < 1)
+    numThreads = 1;
+
+  // Read in the set of branches and the CFG -- from the CFG fragments
+  // if there are any, and otherwise from the text files.
+  program_t prog;
+  set<int> branchSet;
+  csr_graph_t cfg;
+  bool useFragments = readCfgFragments(kFragmentDir, &prog.frags);
+  if (useFragments) {
+    dropStaleFragments(&prog.frags);
+    fprintf(stderr, "Read %d CFG fragments.\n", (int)prog.frags.size());
+    mergeFragments(&prog, &cfg, &branchSet);
+    writeBranches(prog);
+  } else {
+    readBranches(&branchSet);
+    readCfg(&cfg);
+  }
+  fprintf(stderr, "Read %d branches.\n", (int)branchSet.size());
+  vector<int> branches(branchSet.begin(), branchSet.end());
+  fprintf(stderr, "Read %d nodes.\n", (int)cfg.size());
+
+  // An edge has length 1 if its destination is a branch, and zero
+  // otherwise.
+  vector<char> isBranch(cfg.size(), 0);
+  for (size_t i = 0; i < branches.size(); i++) {
+    if ((branches[i] >= 0) && ((size_t)branches[i] < cfg.size()))
+      isBranch[branches[i]] = 1;
+  }
+
+  // Only the fragments distinguish calls from other CFG edges, so only
+  // with them are there function summaries.
+  if (useFragments) {
+    vector<int> exitDist;
+    computeSummaries(prog, isBranch, &exitDist);
+    writeSummaries(branches, exitDist);
+  } else {
+    unlink(kSummaryFile);
+  }
+
+  // With fragments, reuse the results of the last run wherever they
+  // cannot have changed.
+  vector< vector<int> > nbhrs(branches.size());
+  vector<char> done(branches.size(), 0);
+  cfg_cache_t oldCache;
+  vector<int> reused;
+  if (useFragments) {
+    readCfgCache(kCacheFile, &oldCache);
+    reuseCachedResults(prog, oldCache, branches, &reused, &nbhrs, &done);
+  }
+  vector<int> todo;
+  for (size_t i = 0; i < branches.size(); i++) {
+    if (!done[i])
+      todo.push_back(i);
+  }
+  if (useFragments) {
+    fprintf(stderr, "Reused results for %d of %d branches.\n",
+            (int)(branches.size() - todo.size()), (int)branches.size());
+  }
+
+  // "Thin" the graph down to unit-length edges between branches by
+  // finding, for each branch, all other branches distance one away.
+  // The branches are divided among the threads.
+  vector< vector<int> > deps(useFragments ? branches.size() : 0);
+  vector< vector<int> > undefs(useFragments ? branches.size() : 0);
+  vector<worker_t> workers(numThreads);
+  vector<pthread_t> threads(numThreads);
+  for (int t = 0; t < numThreads; t++) {
+    workers[t].cfg = &cfg;
+    workers[t].isBranch = &isBranch;
+    workers[t].branches = &branches;
+    workers[t].todo = &todo;
+    workers[t].first = t;
+    workers[t].stride = numThreads;
+    workers[t].nbhrs = &nbhrs;
+    workers[t].prog = useFragments ? &prog : NULL;
+    workers[t].deps = &deps;
+    workers[t].undefs = &undefs;
+  }
+  for (int t = 1; t < numThreads; t++) {
+    if (pthread_create(&threads[t], NULL, runWorker, &workers[t])) {
+      perror("Failed to create thread");
+      exit(-1);
+    }
+  }
+  runWorker(&workers[0]);
+  for (int t = 1; t < numThreads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  if (useFragments) {
+    cfg_cache_t cache;
+    buildCache(prog, branches, nbhrs, deps, undefs, oldCache, reused, &cache);
+    if (!writeCfgCache(kCacheFile, cache))
+      fprintf(stderr, "Failed to write %s.\n", kCacheFile);
   }
 
+  // Print out an adjacency list for the thinned graph.
   std::ofstream out("cfg_branches", std::ios::out | std::ios::binary);
   size_t len = branches.size();
   out.write((char*)&len, sizeof(len));
 
-  // "Thin" the graph down to unit-length edges between branches by, for each
-  // branch, running Dijstrak's Algorithm until all other branches distance
-  // one away have been discovered.  We print out an adjacency list for the
-  // thinned graph as we go.
-  vector<size_t> dist(cfg.size());
-  vector<int> nbhrs;
   int numEdges = 0;
-  for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
-    // Compute all shortest-paths of length zero and one from vertex i.
-    dijkstra_bounded_shortest_paths(cfg, *i, dist, 1);
-
-    // Accumulate the branch nodes distance one from i.
-    nbhrs.clear();
-    for (BranchIt j = branches.begin(); j != branches.end(); ++j) {
-      if (dist[*j] == 1) {
-	nbhrs.push_back(*j);
-      }
-    }
-    numEdges += nbhrs.size();
+  for (size_t i = 0; i < branches.size(); i++) {
+    numEdges += nbhrs[i].size();
 
     // Write out the neighbors.
-    len = nbhrs.size();
-    int dest = *i;
+    len = nbhrs[i].size();
+    int dest = branches[i];
     out.write((char*)&dest, sizeof(dest));
     out.write((char*)&len, sizeof(len));
-    out.write((char*)&nbhrs.front(), len * sizeof(int));
+    if (len > 0)
+      out.write((char*)&nbhrs[i].front(), len * sizeof(int));
   }
 
   out.close();
@@ -11,24 +11,40 @@
 #include <algorithm>
 #include <assert.h>
 #include <cmath>
+#include <errno.h>
 #include <fstream>
 #include <functional>
 #include <limits>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <queue>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <typeinfo>
+#include <unistd.h>
 #include <utility>
 
+#include "base/execution_view.h"
+#include "base/fork_server.h"
+#include "base/shm_transport.h"
 #include "base/yices_solver.h"
 #include "run_crest/concolic_search.h"
 
 using std::binary_function;
+using std::greater;
 using std::ifstream;
 using std::ios;
+using std::make_pair;
 using std::min;
+using std::min_element;
 using std::max;
 using std::numeric_limits;
 using std::pair;
+using std::priority_queue;
 using std::queue;
 using std::random_shuffle;
 using std::stable_sort;
@@ -39,6 +55,51 @@ namespace {
 
 typedef pair<size_t,int> ScoredBranch;
 
+// A (FNV-1a) hash of the constraints 'slice' of 'ex', as serialized
+// (see SymbolicPred::Serialize) -- hashed straight from the trace.
+unsigned int HashConstraints(const ExecutionView& ex,
+                             const vector<size_t>& slice) {
+  unsigned int h = 2166136261u;
+  for (size_t i = 0; i < slice.size(); i++) {
+    h = (h ^ static_cast<unsigned char>(ex.op(slice[i]))) * 16777619u;
+    const char* p = ex.expr_data(slice[i]);
+    for (size_t j = 0; j < ex.expr_size(slice[i]); j++) {
+      h = (h ^ static_cast<unsigned char>(p[j])) * 16777619u;
+    }
+  }
+  return h;
+}
+
+// The constraints 'slice' of 'ex', decoded for the solver with the last
+// one negated, and deleted with the DecodedSlice.
+class DecodedSlice {
+ public:
+  DecodedSlice(const ExecutionView& ex, const vector<size_t>& slice) {
+    for (size_t i = 0; i < slice.size(); i++) {
+      SymbolicPred* pred = ex.NewPred(slice[i]);
+      if (i + 1 == slice.size()) {
+        pred->Negate();
+      }
+      preds_.push_back(pred);
+    }
+  }
+
+  ~DecodedSlice() {
+    for (size_t i = 0; i < preds_.size(); i++) {
+      delete preds_[i];
+    }
+  }
+
+  const vector<const SymbolicPred*>& preds() const { return preds_; }
+
+ private:
+  vector<const SymbolicPred*> preds_;
+
+  // Disallow copying.
+  DecodedSlice(const DecodedSlice&);
+  void operator=(const DecodedSlice&);
+};
+
 struct ScoredBranchComp
   : public binary_function<ScoredBranch, ScoredBranch, bool>
 {
@@ -47,6 +108,37 @@ struct ScoredBranchComp
   }
 };
 
+// Checkpoint file format version.
+const char kCheckpointMagic[8] = { 'C', 'R', 'S', 'T', 'C', 'K', 'P', '1' };
+
+// Minimum number of seconds between periodic checkpoints.
+const time_t kCheckpointInterval = 60;
+
+template <typename T>
+void AppendRaw(string* s, const T& x) {
+  s->append((const char*)&x, sizeof(x));
+}
+
+template <typename T>
+bool ReadRaw(istream& in, T* x) {
+  in.read((char*)x, sizeof(*x));
+  return !in.fail();
+}
+
+void AppendValues(string* s, const vector<value_t>& v) {
+  AppendRaw(s, v.size());
+  s->append((const char*)&v.front(), v.size() * sizeof(value_t));
+}
+
+bool ReadValues(istream& in, vector<value_t>* v) {
+  size_t len;
+  if (!ReadRaw(in, &len))
+    return false;
+  v->resize(len);
+  in.read((char*)&v->front(), len * sizeof(value_t));
+  return !in.fail();
+}
+
 }  // namespace
 
 
@@ -55,9 +147,19 @@ struct ScoredBranchComp
 ////////////////////////////////////////////////////////////////////////
 
 Search::Search(const string& program, int max_iterations)
-  : program_(program), max_iters_(max_iterations), num_iters_(0) {
+  : job_index_(0), num_jobs_(1),
+    log_new_coverage_(false), use_solver_session_(false),
+    num_skipped_explored_(0), num_skipped_infeasible_(0),
+    num_query_timeouts_(0), num_exec_timeouts_(0), resumed_(false), checkpoint_in_run_program_(true),
+    program_(program), max_iters_(max_iterations), num_iters_(0),
+    shared_(NULL), last_shared_num_covered_(0),
+    use_fork_server_(false), fork_server_pid_(-1),
+    fork_server_ctrl_fd_(-1), fork_server_status_fd_(-1),
+    use_shm_(false), input_fd_(-1), execution_fd_(-1),
+    checkpointing_(false), last_checkpoint_iters_(-1) {
 
   start_time_ = time(NULL);
+  last_checkpoint_time_ = start_time_;
 
   { // Read in the set of branches.
     max_branch_ = 0;
@@ -91,6 +193,7 @@ Search::Search(const string& program, int max_iterations)
     paired_branch_[branches_[i]] = branches_[i+1];
     paired_branch_[branches_[i+1]] = branches_[i];
   }
+  exec_tree_.set_paired_branches(&paired_branch_);
 
   // Compute the branch-to-function map.
   branch_function_.resize(max_branch_);
@@ -137,7 +240,21 @@ Search::Search(const string& program, int max_iterations)
 }
 
 
-Search::~Search() { }
+Search::~Search() {
+  if (solver_cache_.num_lookups() > 0) {
+    PrintSearchStats();
+  }
+  if (fork_server_pid_ > 0) {
+    // Closing the control pipe tells the fork server to exit.
+    close(fork_server_ctrl_fd_);
+    close(fork_server_status_fd_);
+    waitpid(fork_server_pid_, NULL, 0);
+  }
+  if (input_fd_ >= 0) {
+    close(input_fd_);
+    close(execution_fd_);
+  }
+}
 
 
 void Search::WriteInputToFileOrDie(const string& file,
@@ -166,7 +283,7 @@ void Search::WriteCoverageToFileOrDie(const string& file) {
   }
 
   for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
-    if (total_covered_[*i]) {
+    if (shared_ ? shared_->total_covered[*i] : total_covered_[*i]) {
       fprintf(f, "%d\n", *i);
     }
   }
@@ -175,56 +292,310 @@ void Search::WriteCoverageToFileOrDie(const string& file) {
 }
 
 
-void Search::LaunchProgram(const vector<value_t>& inputs) {
-  WriteInputToFileOrDie("input", inputs);
+void Search::RunJobs(int num_jobs) {
+  // Set up the state shared by the jobs.  (Anonymous mappings are
+  // zero-filled.)
+  shared_ = static_cast<SharedState*>(
+      mmap(NULL, sizeof(SharedState) + max_branch_,
+           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  if (shared_ == MAP_FAILED) {
+    perror("Error: Failed to create shared coverage map");
+    exit(-1);
+  }
 
-  /*
+  // Each job needs its own channel to its own copy of the program.
+  use_shm_ = true;
+
+  vector<pid_t> jobs;
+  for (int i = 0; i < num_jobs; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("Error: Failed to fork job");
+      exit(-1);
+    }
+    if (pid == 0) {
+      // Give each job a different random seed.
+      srand(rand() ^ getpid());
+      job_index_ = i;
+      num_jobs_ = num_jobs;
+      Run();
+      PrintSearchStats();
+      exit(0);
+    }
+    jobs.push_back(pid);
+  }
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+    waitpid(jobs[i], NULL, 0);
+  }
+
+  WriteCoverageToFileOrDie("coverage");
+  fprintf(stderr, "All %d jobs done: covered %u branches in %d iterations.\n",
+          num_jobs, shared_->total_num_covered, min(shared_->num_iters, max_iters_));
+}
+
+
+void Search::CreateShmOrDie() {
+  input_fd_ = memfd_create("crest_input", 0);
+  execution_fd_ = memfd_create("crest_execution", 0);
+  if ((input_fd_ < 0) || (execution_fd_ < 0)) {
+    perror("Error: Failed to create shared memory");
+    exit(-1);
+  }
+
+  // The program under test (and any fork server) inherits the
+  // descriptors and finds them through the environment.
+  char buff[32];
+  snprintf(buff, sizeof(buff), "%d", input_fd_);
+  setenv(kInputFdEnv, buff, 1);
+  snprintf(buff, sizeof(buff), "%d", execution_fd_);
+  setenv(kExecutionFdEnv, buff, 1);
+}
+
+
+void Search::WriteInputToShmOrDie(const vector<value_t>& input) {
+  if (input_fd_ < 0) {
+    CreateShmOrDie();
+  }
+
+  ssize_t len = input.size() * sizeof(value_t);
+  if (ftruncate(input_fd_, len)
+      || ((len > 0) && (pwrite(input_fd_, &input.front(), len, 0) != len))
+      || ftruncate(execution_fd_, 0)) {
+    perror("Error: Failed to write input to shared memory");
+    exit(-1);
+  }
+}
+
+
+void Search::StartForkServerOrDie() {
+  int ctrl[2], status[2];
+  if (pipe(ctrl) || pipe(status)) {
+    perror("Error: Failed to create fork server pipes");
+    exit(-1);
+  }
+
+  fork_server_pid_ = fork();
+  if (fork_server_pid_ < 0) {
+    perror("Error: Failed to fork");
+    exit(-1);
+  }
+
+  if (fork_server_pid_ == 0) {
+    // Move the pipe ends to where libcrest expects them, and exec the
+    // program (through the shell, as system() would).
+    if ((dup2(ctrl[0], kForkServerCtrlFd) < 0)
+        || (dup2(status[1], kForkServerStatusFd) < 0)) {
+      _exit(1);
+    }
+    close(ctrl[0]);
+    close(ctrl[1]);
+    close(status[0]);
+    close(status[1]);
+    setenv(kForkServerEnv, "1", 1);
+    execl("/bin/sh", "sh", "-c", program_.c_str(), (char*)NULL);
+    _exit(1);
+  }
+
+  close(ctrl[0]);
+  close(status[1]);
+  fork_server_ctrl_fd_ = ctrl[1];
+  fork_server_status_fd_ = status[0];
+
+  // A broken pipe should be reported as a failed write, not kill us.
+  signal(SIGPIPE, SIG_IGN);
+
+  // Wait for the hello message.
+  int msg;
+  if (read(fork_server_status_fd_, &msg, sizeof(msg)) != sizeof(msg)) {
+    fprintf(stderr, "Fork server failed to start.  (Was %s compiled "
+            "against the current libcrest?)\n", program_.c_str());
+    exit(-1);
+  }
+}
+
+
+bool Search::RunForkServerChildOrDie() {
+  if (fork_server_pid_ < 0) {
+    StartForkServerOrDie();
+  }
+
+  int msg = 0, pid, status;
+  if ((write(fork_server_ctrl_fd_, &msg, sizeof(msg)) != sizeof(msg))
+      || (read(fork_server_status_fd_, &pid, sizeof(pid)) != sizeof(pid))) {
+    fprintf(stderr, "Lost connection to the fork server.\n");
+    exit(-1);
+  }
+
+  // Wait for the exit status, killing the child if it takes too long.
+  bool timed_out = false;
+  const double timeout = budget_.ExecTimeout();
+  if (timeout > 0) {
+    struct pollfd pfd = { fork_server_status_fd_, POLLIN, 0 };
+    if (poll(&pfd, 1, max(static_cast<int>(timeout * 1000), 1)) == 0) {
+      timed_out = true;
+      kill(pid, SIGKILL);
+    }
+  }
+
+  if (read(fork_server_status_fd_, &status, sizeof(status)) != sizeof(status)) {
+    fprintf(stderr, "Lost connection to the fork server.\n");
+    exit(-1);
+  }
+  return !timed_out;
+}
+
+
+bool Search::RunProgramWithTimeoutOrDie(double timeout) {
   pid_t pid = fork();
-  assert(pid != -1);
+  if (pid < 0) {
+    perror("Error: Failed to fork");
+    exit(-1);
+  }
+  if (pid == 0) {
+    // Run the program (through the shell, as system() would) in a
+    // process group of its own, so that all of it can be killed.
+    setpgid(0, 0);
+    execl("/bin/sh", "sh", "-c", program_.c_str(), (char*)NULL);
+    _exit(1);
+  }
+  setpgid(pid, pid);
+
+  // Poll for the program to finish, backing off from 10us to 1ms.
+  const double deadline = SearchBudget::Now() + timeout;
+  useconds_t sleep_us = 10;
+  for (;;) {
+    pid_t res = waitpid(pid, NULL, WNOHANG);
+    if ((res == pid) || ((res < 0) && (errno != EINTR)))
+      return true;
+    if (SearchBudget::Now() >= deadline)
+      break;
+    usleep(sleep_us);
+    sleep_us = min(2 * sleep_us, (useconds_t)1000);
+  }
 
-  if (!pid) {
-    system(program_.c_str());
-    exit(0);
+  kill(-pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  return false;
+}
+
+
+bool Search::LaunchProgram(const vector<value_t>& inputs) {
+  if (use_shm_) {
+    WriteInputToShmOrDie(inputs);
+  } else {
+    WriteInputToFileOrDie("input", inputs);
+  }
+
+  if (use_fork_server_) {
+    return RunForkServerChildOrDie();
+  }
+
+  const double timeout = budget_.ExecTimeout();
+  if (timeout > 0) {
+    return RunProgramWithTimeoutOrDie(timeout);
   }
-  */
 
   system(program_.c_str());
+  return true;
 }
 
 
-void Search::RunProgram(const vector<value_t>& inputs, SymbolicExecution* ex) {
-  if (++num_iters_ > max_iters_) {
-    // TODO(jburnim): Devise a better system for capping the iterations.
-    exit(0);
+bool Search::RunProgram(const vector<value_t>& inputs, ExecutionView* view) {
+  // The program will overwrite the trace underneath any old mapping.
+  view->Close();
+
+  if (Exhausted()) {
+    if (checkpoint_in_run_program_) {
+      MaybeCheckpoint(true);
+    }
+    return false;
+  }
+  if (checkpoint_in_run_program_) {
+    MaybeCheckpoint();
+  }
+
+  if (shared_) {
+    num_iters_ = __sync_add_and_fetch(&shared_->num_iters, 1);
+    if (num_iters_ > max_iters_) {
+      // Another job took the last iteration.
+      budget_.Exhaust("iteration limit");
+      return false;
+    }
+  } else {
+    num_iters_++;
   }
 
   // Run the program.
-  LaunchProgram(inputs);
+  if (!LaunchProgram(inputs)) {
+    fprintf(stderr, "Execution timed out.\n");
+    num_exec_timeouts_++;
+    return true;
+  }
 
-  // Read the execution from the program.
-  // Want to do this with sockets.  (Currently doing it with files.)
-  ifstream in("szd_execution", ios::in | ios::binary);
-  assert(in && ex->Parse(in));
-  in.close();
+  // Map the execution written by the program.  (The trace is incomplete
+  // if the program crashed.)
+  bool success = (use_shm_ ? view->Open(execution_fd_)
+                  : view->Open("szd_execution"));
+  if (!success) {
+    fprintf(stderr, "Failed to read execution.\n");
+    return true;
+  }
+  // Keep the execution past the next run, without decoding it.
+  view->Detach();
+
+  exec_tree_.Insert(view->branches(), view->constraints_idx());
 
   /*
-  for (size_t i = 0; i < ex->path().branches().size(); i++) {
-    fprintf(stderr, "%d ", ex->path().branches()[i]);
+  for (size_t i = 0; i < view->branches().size(); i++) {
+    fprintf(stderr, "%d ", view->branches()[i]);
   }
   fprintf(stderr, "\n");
   */
+
+  return true;
+}
+
+
+bool Search::Exhausted() {
+  if (!budget_.reason()) {
+    int num_iters = shared_ ? shared_->num_iters : num_iters_;
+    if (num_iters >= max_iters_) {
+      budget_.Exhaust("iteration limit");
+    }
+    if (budget_.Exhausted()) {
+      fprintf(stderr, "Search stopped at iteration %d (%.0fs): %s "
+              "reached.\n", num_iters_, budget_.elapsed(), budget_.reason());
+    }
+  }
+  return (budget_.reason() != NULL);
+}
+
+
+void Search::PrintSearchStats() {
+  solver_cache_.PrintStats();
+  fprintf(stderr, "Execution tree: %zu nodes, skipped %u explored "
+          "and %u infeasible paths\n", exec_tree_.num_nodes(),
+          num_skipped_explored_, num_skipped_infeasible_);
+  fprintf(stderr, "Budget: %.1fs elapsed, %.1fs in solver, %u query "
+          "timeouts, %u execution timeouts\n", budget_.elapsed(),
+          budget_.solver_time(), num_query_timeouts_, num_exec_timeouts_);
 }
 
 
-bool Search::UpdateCoverage(const SymbolicExecution& ex) {
+bool Search::UpdateCoverage(const ExecutionView& ex) {
   return UpdateCoverage(ex, NULL);
 }
 
-bool Search::UpdateCoverage(const SymbolicExecution& ex,
+bool Search::UpdateCoverage(const ExecutionView& ex,
+			    set<branch_id_t>* new_branches) {
+  return UpdateCoverage(ex.branches(), new_branches);
+}
+
+bool Search::UpdateCoverage(const vector<branch_id_t>& branches,
 			    set<branch_id_t>* new_branches) {
 
   const unsigned int prev_covered_ = num_covered_;
-  const vector<branch_id_t>& branches = ex.path().branches();
   for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
     if ((*i > 0) && !covered_[*i]) {
       covered_[*i] = true;
@@ -232,6 +603,9 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex,
       if (new_branches) {
 	new_branches->insert(*i);
       }
+      if (log_new_coverage_) {
+        newly_covered_.push_back(*i);
+      }
       if (!reached_[branch_function_[*i]]) {
 	reached_[branch_function_[*i]] = true;
 	reachable_functions_ ++;
@@ -241,21 +615,183 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex,
     if ((*i > 0) && !total_covered_[*i]) {
       total_covered_[*i] = true;
       total_num_covered_++;
+      if (shared_ &&
+          __sync_bool_compare_and_swap(&shared_->total_covered[*i], 0, 1)) {
+        __sync_add_and_fetch(&shared_->total_num_covered, 1);
+      }
     }
   }
 
+  bool found_new_branch = (num_covered_ > prev_covered_);
+
+  if (shared_) {
+    MergeSharedCoverage();
+  }
+
   fprintf(stderr, "Iteration %d (%lds): covered %u branches [%u reach funs, %u reach branches].\n",
 	  num_iters_, time(NULL)-start_time_, total_num_covered_, reachable_functions_, reachable_branches_);
 
-  bool found_new_branch = (num_covered_ > prev_covered_);
   if (found_new_branch) {
-    WriteCoverageToFileOrDie("coverage");
+    if (shared_) {
+      // Other jobs may be writing the file, too, so write it atomically.
+      char tmp[32];
+      snprintf(tmp, sizeof(tmp), "coverage.%d", getpid());
+      WriteCoverageToFileOrDie(tmp);
+      rename(tmp, "coverage");
+    } else {
+      WriteCoverageToFileOrDie("coverage");
+    }
   }
 
   return found_new_branch;
 }
 
 
+void Search::MaybeCheckpoint(bool finished) {
+  if (!checkpointing_ || (num_iters_ == last_checkpoint_iters_))
+    return;
+
+  // Checkpoint periodically, and once the search is done or exhausted.
+  if (!finished
+      && (time(NULL) - last_checkpoint_time_ < kCheckpointInterval))
+    return;
+
+  WriteCheckpointOrDie();
+}
+
+
+void Search::WriteCheckpointOrDie() {
+  string s;
+  s.append(kCheckpointMagic, sizeof(kCheckpointMagic));
+
+  // The strategy, which must match on resume.
+  string name = typeid(*this).name();
+  AppendRaw(&s, name.size());
+  s.append(name);
+
+  AppendRaw(&s, max_branch_);
+  AppendRaw(&s, num_iters_);
+  AppendRaw(&s, time(NULL) - start_time_);
+  AppendRaw(&s, budget_.elapsed());
+  AppendRaw(&s, budget_.solver_time());
+  for (branch_id_t i = 0; i < max_branch_; i++) {
+    s.push_back(static_cast<char>(covered_[i] | (total_covered_[i] << 1)));
+  }
+  exec_tree_.Serialize(&s);
+  SaveState(&s);
+
+  // Write the checkpoint atomically.
+  FILE* f = fopen("checkpoint.tmp", "wb");
+  if (!f || (fwrite(s.data(), 1, s.size(), f) != s.size()) || fclose(f)) {
+    perror("Error: Failed to write checkpoint");
+    exit(-1);
+  }
+  if (rename("checkpoint.tmp", "checkpoint")) {
+    perror("Error: Failed to rename checkpoint");
+    exit(-1);
+  }
+
+  last_checkpoint_time_ = time(NULL);
+  last_checkpoint_iters_ = num_iters_;
+}
+
+
+void Search::ResumeOrDie() {
+  ifstream in("checkpoint", ios::in | ios::binary);
+  if (!in) {
+    fprintf(stderr, "Failed to open checkpoint.\n");
+    exit(-1);
+  }
+
+  char magic[sizeof(kCheckpointMagic)];
+  in.read(magic, sizeof(magic));
+  if (in.fail() || memcmp(magic, kCheckpointMagic, sizeof(magic))) {
+    fprintf(stderr, "Not a checkpoint file: checkpoint\n");
+    exit(-1);
+  }
+
+  size_t len;
+  string name;
+  branch_id_t max_branch;
+  time_t elapsed;
+  double budget_elapsed, solver_time;
+  bool success = (ReadRaw(in, &len) && (len < 4096));
+  if (success) {
+    name.resize(len);
+    in.read(&name[0], len);
+    success = (!in.fail() && (name == typeid(*this).name()));
+    if (!success)
+      fprintf(stderr, "Checkpoint is from a different strategy.\n");
+  }
+  success = success && ReadRaw(in, &max_branch) && (max_branch == max_branch_);
+  success = success && ReadRaw(in, &num_iters_) && ReadRaw(in, &elapsed)
+    && ReadRaw(in, &budget_elapsed) && ReadRaw(in, &solver_time);
+
+  // Restore the coverage.
+  total_num_covered_ = num_covered_ = 0;
+  for (branch_id_t i = 0; success && (i < max_branch_); i++) {
+    int c = in.get();
+    covered_[i] = (c & 1);
+    total_covered_[i] = (c & 2);
+    if (covered_[i]) {
+      num_covered_ ++;
+      if (!reached_[branch_function_[i]]) {
+	reached_[branch_function_[i]] = true;
+	reachable_functions_ ++;
+	reachable_branches_ += branch_count_[branch_function_[i]];
+      }
+    }
+    if (total_covered_[i])
+      total_num_covered_ ++;
+  }
+
+  success = success && !in.fail() && exec_tree_.Parse(in) && LoadState(in);
+  if (!success) {
+    fprintf(stderr, "Failed to load checkpoint.\n");
+    exit(-1);
+  }
+
+  resumed_ = true;
+  start_time_ = time(NULL) - elapsed;
+  budget_.Start(budget_elapsed);
+  budget_.set_solver_time(solver_time);
+  last_checkpoint_iters_ = num_iters_;
+  fprintf(stderr, "Resumed at iteration %d (%lds): covered %u branches "
+          "[%u reach funs, %u reach branches].\n", num_iters_, elapsed,
+          total_num_covered_, reachable_functions_, reachable_branches_);
+}
+
+
+void Search::MergeSharedCoverage() {
+  // Only scan the shared map if some job has covered a new branch.
+  unsigned int shared_num_covered = shared_->total_num_covered;
+  if (shared_num_covered == last_shared_num_covered_)
+    return;
+  last_shared_num_covered_ = shared_num_covered;
+
+  // Treat branches covered by other jobs as covered, so that this job
+  // searches for the branches that no job has covered yet.
+  for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
+    if (shared_->total_covered[*i] && !total_covered_[*i]) {
+      total_covered_[*i] = true;
+      total_num_covered_++;
+    }
+    if (shared_->total_covered[*i] && !covered_[*i]) {
+      covered_[*i] = true;
+      num_covered_++;
+      if (log_new_coverage_) {
+        newly_covered_.push_back(*i);
+      }
+      if (!reached_[branch_function_[*i]]) {
+	reached_[branch_function_[*i]] = true;
+	reachable_functions_ ++;
+	reachable_branches_ += branch_count_[branch_function_[*i]];
+      }
+    }
+  }
+}
+
+
 void Search::RandomInput(const map<var_t,type_t>& vars, vector<value_t>* input) {
   input->resize(vars.size());
 
@@ -290,27 +826,83 @@ void Search::RandomInput(const map<var_t,type_t>& vars, vector<value_t>* input)
 }
 
 
-bool Search::SolveAtBranch(const SymbolicExecution& ex,
+bool Search::SolveAtBranch(const ExecutionView& ex,
                            size_t branch_idx,
                            vector<value_t>* input) {
 
-  const vector<SymbolicPred*>& constraints = ex.path().constraints();
+  if (Exhausted())
+    return false;
 
-  // Optimization: If any of the previous constraints are idential to the
-  // branch_idx-th constraint, immediately return false.
-  for (int i = static_cast<int>(branch_idx) - 1; i >= 0; i--) {
-    if (constraints[branch_idx]->Equal(*constraints[i]))
-      return false;
+  // Skip the branch if the path we would take by negating it has already
+  // been explored, or is known to be infeasible.
+  const branch_id_t target =
+    paired_branch_[ex.branches()[ex.constraints_idx()[branch_idx]]];
+  // (A query started by SolveAhead before another candidate explored
+  // the path is discarded.)
+  const SolverPool::Key key(&ex, branch_idx);
+  const bool speculated = solver_pool_.IsPending(key);
+  bool infeasible;
+  unsigned int infeasible_hash;
+  const bool known = exec_tree_.IsKnown(ex, branch_idx, target,
+                                        &infeasible, &infeasible_hash);
+  if (known && !infeasible) {
+    num_skipped_explored_++;
+    if (speculated) {
+      solver_pool_.Discard(key);
+      budget_.AddSolverTime(solver_pool_.TakeSolverTime());
+    }
+    return false;
+  }
+
+  // A path is only known to be infeasible for the same slice of
+  // constraints.  (The same branches can carry different constraints,
+  // when some operands were concretized.)
+  vector<size_t> slice;
+  const bool duplicate = !DependentConstraints(ex, branch_idx, &slice);
+  const unsigned int slice_hash = HashConstraints(ex, slice);
+  if (known && (infeasible_hash == slice_hash)) {
+    num_skipped_infeasible_++;
+    if (speculated) {
+      solver_pool_.Discard(key);
+      budget_.AddSolverTime(solver_pool_.TakeSolverTime());
+    }
+    return false;
+  }
+  if (duplicate) {
+    exec_tree_.MarkInfeasible(ex, branch_idx, target, slice_hash);
+    return false;
   }
 
-  vector<const SymbolicPred*> cs(constraints.begin(),
-				 constraints.begin()+branch_idx+1);
+  DecodedSlice dependent(ex, slice);
   map<var_t,value_t> soln;
-  constraints[branch_idx]->Negate();
   // fprintf(stderr, "Yices . . . ");
-  bool success = YicesSolver::IncrementalSolve(ex.inputs(), ex.vars(), cs, &soln);
+  YicesSolver::set_query_timeout(budget_.query_timeout());
+  const unsigned int timeouts = YicesSolver::num_query_timeouts();
+  // A speculative query is charged the CPU time of its solver process,
+  // not the time spent waiting for it.
+  const double start = SearchBudget::Now();
+  bool success;
+  if (speculated) {
+    success = solver_pool_.Finish(key, ex.inputs(), ex.vars(),
+                                  dependent.preds(), &soln, &solver_cache_);
+  } else if (use_solver_session_) {
+    // The session only asserts the slice, and the solution is merged with
+    // the old input below, so the rest of the path is not needed.
+    success = solver_session_.IncrementalSolve(ex.inputs(), ex.vars(),
+                                               dependent.preds(),
+                                               dependent.preds(), &soln,
+                                               &solver_cache_);
+  } else {
+    success = YicesSolver::SolveSlice(ex.inputs(), ex.vars(),
+                                      dependent.preds(), &soln,
+                                      &solver_cache_);
+  }
   // fprintf(stderr, "%d\n", success);
-  constraints[branch_idx]->Negate();
+  if (speculated) {
+    budget_.AddSolverTime(solver_pool_.TakeSolverTime());
+  } else {
+    budget_.AddSolverTime(SearchBudget::Now() - start);
+  }
 
   if (success) {
     // Merge the solution with the previous input to get the next
@@ -325,26 +917,94 @@ bool Search::SolveAtBranch(const SymbolicExecution& ex,
     return true;
   }
 
+  if (YicesSolver::num_query_timeouts() != timeouts) {
+    // The path is not known to be infeasible.
+    num_query_timeouts_++;
+    return false;
+  }
+  exec_tree_.MarkInfeasible(ex, branch_idx, target, slice_hash);
   return false;
 }
 
 
-bool Search::CheckPrediction(const SymbolicExecution& old_ex,
-			     const SymbolicExecution& new_ex,
+bool Search::DependentConstraints(const ExecutionView& ex,
+                                  size_t branch_idx,
+                                  vector<size_t>* slice) {
+  ex.DependentConstraints(branch_idx, slice);
+
+  // Optimization: If any of the previous constraints are idential to the
+  // branch_idx-th constraint, return false.  (Any such constraint has the
+  // same variables, so it is in the slice.)
+  for (size_t i = 0; i < slice->size(); i++) {
+    if (((*slice)[i] != branch_idx) && ex.Equal(branch_idx, (*slice)[i]))
+      return false;
+  }
+  return true;
+}
+
+
+void Search::SolveAhead(const ExecutionView& ex,
+                        const vector<ScoredBranch>& branches,
+                        size_t next, int max_score) {
+  if (solver_pool_.size() == 0)
+    return;
+
+  size_t& speculative_next = speculative_next_[&ex];
+  YicesSolver::set_query_timeout(budget_.query_timeout());
+  vector<size_t> slice;
+  for (size_t i = max(next, speculative_next);
+       (i < branches.size()) && !solver_pool_.full(); i++) {
+    if ((branches[i].second > max_score) || Exhausted())
+      break;
+    speculative_next = i + 1;
+
+    // Skip the candidates which SolveAtBranch would skip without calling
+    // the solver.
+    const size_t idx = branches[i].first;
+    const SolverPool::Key key(&ex, idx);
+    const branch_id_t target =
+      paired_branch_[ex.branches()[ex.constraints_idx()[idx]]];
+    bool infeasible = false;
+    unsigned int infeasible_hash;
+    if (solver_pool_.IsPending(key)
+        || (exec_tree_.IsKnown(ex, idx, target, &infeasible, &infeasible_hash)
+            && !infeasible)
+        || !DependentConstraints(ex, idx, &slice)
+        || (infeasible && (infeasible_hash == HashConstraints(ex, slice)))) {
+      continue;
+    }
+
+    DecodedSlice dependent(ex, slice);
+    solver_pool_.Start(key, ex.vars(), dependent.preds());
+  }
+}
+
+
+void Search::CancelSpeculation(const ExecutionView& ex) {
+  if (solver_pool_.size() == 0)
+    return;
+  solver_pool_.DiscardGroup(&ex);
+  speculative_next_.erase(&ex);
+  budget_.AddSolverTime(solver_pool_.TakeSolverTime());
+}
+
+
+bool Search::CheckPrediction(const ExecutionView& old_ex,
+			     const ExecutionView& new_ex,
 			     size_t branch_idx) {
 
-  if ((old_ex.path().branches().size() <= branch_idx)
-      || (new_ex.path().branches().size() <= branch_idx)) {
+  if ((old_ex.branches().size() <= branch_idx)
+      || (new_ex.branches().size() <= branch_idx)) {
     return false;
   }
 
    for (size_t j = 0; j < branch_idx; j++) {
-     if  (new_ex.path().branches()[j] != old_ex.path().branches()[j]) {
+     if  (new_ex.branches()[j] != old_ex.branches()[j]) {
        return false;
      }
    }
-   return (new_ex.path().branches()[branch_idx]
-           == paired_branch_[old_ex.path().branches()[branch_idx]]);
+   return (new_ex.branches()[branch_idx]
+           == paired_branch_[old_ex.branches()[branch_idx]]);
 }
 
 
@@ -354,18 +1014,66 @@ bool Search::CheckPrediction(const SymbolicExecution& old_ex,
 
 BoundedDepthFirstSearch::BoundedDepthFirstSearch
 (const string& program, int max_iterations, int max_depth)
-  : Search(program, max_iterations), max_depth_(max_depth) { }
+  : Search(program, max_iterations), max_depth_(max_depth) {
+  // Consecutive solves share the path prefix up to the current depth.
+  use_solver_session_ = true;
+  // The DFS stack is only consistent between iterations of DFS().
+  checkpoint_in_run_program_ = false;
+}
 
-BoundedDepthFirstSearch::~BoundedDepthFirstSearch() { }
+BoundedDepthFirstSearch::~BoundedDepthFirstSearch() {
+  ClearStack();
+}
 
 void BoundedDepthFirstSearch::Run() {
-  // Initial execution (on empty/random inputs).
-  SymbolicExecution ex;
-  RunProgram(vector<value_t>(), &ex);
-  UpdateCoverage(ex);
+  if (!resumed_) {
+    // Initial execution (on empty/random inputs).
+    Frame f;
+    f.ex = new ExecutionView();
+    f.pos = 0;
+    f.depth = max_depth_;
+    if (!RunProgram(vector<value_t>(), f.ex)) {
+      delete f.ex;
+      return;
+    }
+    UpdateCoverage(*f.ex);
+    stack_.push_back(f);
+  }
+
+  DFS();
+}
+
+void BoundedDepthFirstSearch::ClearStack() {
+  for (size_t i = 0; i < stack_.size(); i++) {
+    delete stack_[i].ex;
+  }
+  stack_.clear();
+}
+
+void BoundedDepthFirstSearch::SaveState(string* s) const {
+  AppendRaw(s, stack_.size());
+  for (size_t i = 0; i < stack_.size(); i++) {
+    stack_[i].ex->Serialize(s);
+    AppendRaw(s, stack_[i].pos);
+    AppendRaw(s, stack_[i].depth);
+  }
+}
 
-  DFS(0, max_depth_, ex);
-  // DFS(0, ex);
+bool BoundedDepthFirstSearch::LoadState(istream& in) {
+  ClearStack();
+  size_t len;
+  if (!ReadRaw(in, &len))
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    Frame f;
+    f.ex = new ExecutionView();
+    stack_.push_back(f);
+    if (!f.ex->Parse(in)
+        || !ReadRaw(in, &stack_.back().pos)
+        || !ReadRaw(in, &stack_.back().depth))
+      return false;
+  }
+  return true;
 }
 
   /*
@@ -400,33 +1108,216 @@ void BoundedDepthFirstSearch::DFS(int depth, SymbolicExecution& prev_ex) {
   */
 
 
-void BoundedDepthFirstSearch::DFS(size_t pos, int depth, SymbolicExecution& prev_ex) {
-  SymbolicExecution cur_ex;
+void BoundedDepthFirstSearch::DFS() {
   vector<value_t> input;
 
-  const SymbolicPath& path = prev_ex.path();
+  while (!stack_.empty() && !Exhausted()) {
+    MaybeCheckpoint();
 
-  for (size_t i = pos; (i < path.constraints().size()) && (depth > 0); i++) {
-    // Solve constraints[0..i].
-    if (!SolveAtBranch(prev_ex, i, &input)) {
+    Frame& f = stack_.back();
+    if ((f.pos >= f.ex->num_constraints()) || (f.depth <= 0)) {
+      delete f.ex;
+      stack_.pop_back();
+      continue;
+    }
+
+    // Solve constraints[0..i].  (The bottom frame is the initial
+    // execution.)
+    size_t i = f.pos++;
+    if ((stack_.size() == 1) && !OwnsInitialFlip(i)) {
+      continue;
+    }
+    if (!SolveAtBranch(*f.ex, i, &input)) {
       continue;
     }
 
     // Run on those constraints.
-    RunProgram(input, &cur_ex);
-    UpdateCoverage(cur_ex);
+    ExecutionView* cur_ex = new ExecutionView();
+    if (!RunProgram(input, cur_ex)) {
+      // Leave the frame as it was, for any checkpoint.
+      f.pos = i;
+      delete cur_ex;
+      break;
+    }
+    UpdateCoverage(*cur_ex);
 
     // Check for prediction failure.
-    size_t branch_idx = path.constraints_idx()[i];
-    if (!CheckPrediction(prev_ex, cur_ex, branch_idx)) {
+    size_t branch_idx = f.ex->constraints_idx()[i];
+    if (!CheckPrediction(*f.ex, *cur_ex, branch_idx)) {
       fprintf(stderr, "Prediction failed!\n");
+      delete cur_ex;
       continue;
     }
 
     // We successfully solved the branch, recurse.
-    depth--;
-    DFS(i+1, depth, cur_ex);
+    f.depth--;
+    Frame child;
+    child.ex = cur_ex;
+    child.pos = i+1;
+    child.depth = f.depth;
+    stack_.push_back(child);
+  }
+
+  MaybeCheckpoint(true);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+//// GenerationalSearch ////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+GenerationalSearch::GenerationalSearch(const string& program,
+                                       int max_iterations)
+  : Search(program, max_iterations), num_children_(0) {
+  // Each expansion solves at successive constraints of one path.
+  use_solver_session_ = true;
+  // The queue is only consistent between iterations of Run().
+  checkpoint_in_run_program_ = false;
+}
+
+GenerationalSearch::~GenerationalSearch() {
+  for (size_t i = 0; i < queue_.size(); i++) {
+    delete queue_[i].ex;
+  }
+}
+
+void GenerationalSearch::Run() {
+  if (!resumed_) {
+    // Initial execution (on empty/random inputs).
+    ExecutionView* ex = new ExecutionView();
+    if (!RunProgram(vector<value_t>(), ex)) {
+      delete ex;
+      return;
+    }
+    UpdateCoverage(*ex);
+    Enqueue(ex, 0, 0);
+  }
+
+  set<branch_id_t> new_branches;
+  while ((!queue_.empty() || !pending_.empty()) && !Exhausted()) {
+    MaybeCheckpoint();
+
+    if (!pending_.empty()) {
+      // Run and score the next child.
+      ExecutionView* child = new ExecutionView();
+      if (!RunProgram(pending_.back().second, child)) {
+        delete child;
+        break;
+      }
+      new_branches.clear();
+      UpdateCoverage(*child, &new_branches);
+      Enqueue(child, pending_.back().first, new_branches.size());
+      pending_.pop_back();
+      continue;
+    }
+
+    // Expand the best execution.
+    pop_heap(queue_.begin(), queue_.end(), ChildLess());
+    Child c = queue_.back();
+    queue_.pop_back();
+    Expand(*c.ex, c.bound, c.seq == 0);
+    if (Exhausted()) {
+      // The expansion may have been cut short, so put the execution back
+      // (for any checkpoint) to be expanded again.
+      pending_.clear();
+      queue_.push_back(c);
+      push_heap(queue_.begin(), queue_.end(), ChildLess());
+      break;
+    }
+    delete c.ex;
+  }
+
+  MaybeCheckpoint(true);
+}
+
+void GenerationalSearch::Enqueue(ExecutionView* ex, size_t bound,
+                                 unsigned int score) {
+  Child c;
+  c.ex = ex;
+  c.bound = bound;
+  c.score = score;
+  c.seq = num_children_++;
+  queue_.push_back(c);
+  push_heap(queue_.begin(), queue_.end(), ChildLess());
+
+  if (queue_.size() > kMaxQueued) {
+    vector<Child>::iterator worst =
+      min_element(queue_.begin(), queue_.end(), ChildLess());
+    delete worst->ex;
+    *worst = queue_.back();
+    queue_.pop_back();
+    make_heap(queue_.begin(), queue_.end(), ChildLess());
+  }
+}
+
+void GenerationalSearch::Expand(const ExecutionView& ex, size_t bound,
+                                bool initial) {
+  // Solve at every constraint past the bound, in order, so that
+  // consecutive queries extend each other's prefixes.  The children are
+  // run (in the same order) by Run().
+  for (size_t i = ex.num_constraints(); i > bound; i--) {
+    pending_.push_back(make_pair(i, vector<value_t>()));
+  }
+  for (size_t i = pending_.size(); i > 0; i--) {
+    pair<size_t, vector<value_t> >& p = pending_[i-1];
+    if ((initial && !OwnsInitialFlip(p.first - 1))
+        || !SolveAtBranch(ex, p.first - 1, &p.second)) {
+      p.first = 0;
+    }
+  }
+
+  // Drop the constraints which could not be negated.
+  size_t j = 0;
+  for (size_t i = 0; i < pending_.size(); i++) {
+    if (pending_[i].first > 0) {
+      pending_[j].first = pending_[i].first;
+      pending_[j].second.swap(pending_[i].second);
+      j++;
+    }
+  }
+  pending_.resize(j);
+}
+
+void GenerationalSearch::SaveState(string* s) const {
+  AppendRaw(s, num_children_);
+  AppendRaw(s, queue_.size());
+  for (size_t i = 0; i < queue_.size(); i++) {
+    queue_[i].ex->Serialize(s);
+    AppendRaw(s, queue_[i].bound);
+    AppendRaw(s, queue_[i].score);
+    AppendRaw(s, queue_[i].seq);
+  }
+  AppendRaw(s, pending_.size());
+  for (size_t i = 0; i < pending_.size(); i++) {
+    AppendRaw(s, pending_[i].first);
+    AppendValues(s, pending_[i].second);
+  }
+}
+
+bool GenerationalSearch::LoadState(istream& in) {
+  size_t len;
+  if (!ReadRaw(in, &num_children_) || !ReadRaw(in, &len))
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    Child c;
+    c.ex = new ExecutionView();
+    queue_.push_back(c);
+    Child& d = queue_.back();
+    if (!d.ex->Parse(in) || !ReadRaw(in, &d.bound)
+        || !ReadRaw(in, &d.score) || !ReadRaw(in, &d.seq))
+      return false;
   }
+  // The queue was saved as a heap.
+
+  if (!ReadRaw(in, &len))
+    return false;
+  pending_.resize(len);
+  for (size_t i = 0; i < len; i++) {
+    if (!ReadRaw(in, &pending_[i].first)
+        || !ReadValues(in, &pending_[i].second))
+      return false;
+  }
+  return true;
 }
 
 
@@ -440,13 +1331,17 @@ RandomInputSearch::RandomInputSearch(const string& program, int max_iterations)
 RandomInputSearch::~RandomInputSearch() { }
 
 void RandomInputSearch::Run() {
+  // Only the inputs and branches of each execution are needed, so the
+  // constraints are never decoded.
   vector<value_t> input;
-  RunProgram(input, &ex_);
+  if (!RunProgram(input, &view_))
+    return;
 
   while (true) {
-    RandomInput(ex_.vars(), &input);
-    RunProgram(input, &ex_);
-    UpdateCoverage(ex_);
+    RandomInput(view_.vars(), &input);
+    if (!RunProgram(input, &view_))
+      return;
+    UpdateCoverage(view_.branches(), NULL);
   }
 }
 
@@ -461,13 +1356,14 @@ RandomSearch::RandomSearch(const string& program, int max_iterations)
 RandomSearch::~RandomSearch() { }
 
 void RandomSearch::Run() {
-  SymbolicExecution next_ex;
+  ExecutionView next_ex;
 
   while (true) {
     // Execution (on empty/random inputs).
     fprintf(stderr, "RESET\n");
     vector<value_t> next_input;
-    RunProgram(next_input, &ex_);
+    if (!RunProgram(next_input, &ex_))
+      return;
     UpdateCoverage(ex_);
 
     // Do some iterations.
@@ -478,10 +1374,11 @@ void RandomSearch::Run() {
 
       size_t idx;
       if (SolveRandomBranch(&next_input, &idx)) {
-	RunProgram(next_input, &next_ex);
+	if (!RunProgram(next_input, &next_ex))
+	  return;
 	bool found_new_branch = UpdateCoverage(next_ex);
 	bool prediction_failed =
-	  !CheckPrediction(ex_, next_ex, ex_.path().constraints_idx()[idx]);
+	  !CheckPrediction(ex_, next_ex, ex_.constraints_idx()[idx]);
 
 	if (found_new_branch) {
 	  count = 0;
@@ -493,6 +1390,9 @@ void RandomSearch::Run() {
 	} else {
 	  fprintf(stderr, "Prediction failed.\n");
 	}
+      } else {
+	// No branch could be forced to a new path, so start over.
+	break;
       }
     }
   }
@@ -540,21 +1440,21 @@ bool RandomSearch::SolveUncoveredBranches(SymbolicExecution& prev_ex) {
   */
 
 void RandomSearch::SolveUncoveredBranches(size_t i, int depth,
-					  const SymbolicExecution& prev_ex) {
+					  const ExecutionView& prev_ex) {
   if (depth < 0)
     return;
 
   fprintf(stderr, "position: %zu/%zu (%d)\n",
-	  i, prev_ex.path().constraints().size(), depth);
+	  i, prev_ex.num_constraints(), depth);
 
-  SymbolicExecution cur_ex;
+  ExecutionView cur_ex;
   vector<value_t> input;
 
   int cnt = 0;
 
-  for (size_t j = i; j < prev_ex.path().constraints().size(); j++) {
-    size_t bid_idx = prev_ex.path().constraints_idx()[j];
-    branch_id_t bid = prev_ex.path().branches()[bid_idx];
+  for (size_t j = i; j < prev_ex.num_constraints(); j++) {
+    size_t bid_idx = prev_ex.constraints_idx()[j];
+    branch_id_t bid = prev_ex.branches()[bid_idx];
     if (covered_[paired_branch_[bid]])
       continue;
 
@@ -562,13 +1462,14 @@ void RandomSearch::SolveUncoveredBranches(size_t i, int depth,
       if (++cnt == 1000) {
 	cnt = 0;
 	fprintf(stderr, "Failed to solve at %zu/%zu.\n",
-		j, prev_ex.path().constraints().size());
+		j, prev_ex.num_constraints());
       }
       continue;
     }
     cnt = 0;
 
-    RunProgram(input, &cur_ex);
+    if (!RunProgram(input, &cur_ex))
+      return;
     UpdateCoverage(cur_ex);
     if (!CheckPrediction(prev_ex, cur_ex, bid_idx)) {
       fprintf(stderr, "Prediction failed.\n");
@@ -619,7 +1520,7 @@ void RandomSearch::SolveUncoveredBranches(size_t i, int depth,
   }
   */
 
-  vector<size_t> idxs(ex_.path().constraints().size());
+  vector<size_t> idxs(ex_.num_constraints());
   for (size_t i = 0; i < idxs.size(); i++)
     idxs[i] = i;
 
@@ -659,34 +1560,42 @@ UniformRandomSearch::~UniformRandomSearch() { }
 
 void UniformRandomSearch::Run() {
   // Initial execution (on empty/random inputs).
-  RunProgram(vector<value_t>(), &prev_ex_);
+  if (!RunProgram(vector<value_t>(), &prev_ex_))
+    return;
   UpdateCoverage(prev_ex_);
 
-  while (true) {
+  while (!Exhausted()) {
     fprintf(stderr, "RESET\n");
 
     // Uniform random path.
-    DoUniformRandomPath();
+    if (!DoUniformRandomPath()) {
+      // Every branch of the path leads somewhere already explored, so
+      // start over from a random input.
+      if (!RunProgram(vector<value_t>(), &prev_ex_))
+        return;
+      UpdateCoverage(prev_ex_);
+    }
   }
 }
 
-void UniformRandomSearch::DoUniformRandomPath() {
+bool UniformRandomSearch::DoUniformRandomPath() {
   vector<value_t> input;
 
   size_t i = 0;
   size_t depth = 0;
-  fprintf(stderr, "%zu constraints.\n", prev_ex_.path().constraints().size());
-  while ((i < prev_ex_.path().constraints().size()) && (depth < max_depth_)) {
+  fprintf(stderr, "%zu constraints.\n", prev_ex_.num_constraints());
+  while ((i < prev_ex_.num_constraints()) && (depth < max_depth_)) {
     if (SolveAtBranch(prev_ex_, i, &input)) {
       fprintf(stderr, "Solved constraint %zu/%zu.\n",
-	      (i+1), prev_ex_.path().constraints().size());
+	      (i+1), prev_ex_.num_constraints());
       depth++;
 
       // With probability 0.5, force the i-th constraint.
       if (rand() % 2 == 0) {
-	RunProgram(input, &cur_ex_);
+	if (!RunProgram(input, &cur_ex_))
+	  return false;
 	UpdateCoverage(cur_ex_);
-	size_t branch_idx = prev_ex_.path().constraints_idx()[i];
+	size_t branch_idx = prev_ex_.constraints_idx()[i];
 	if (!CheckPrediction(prev_ex_, cur_ex_, branch_idx)) {
 	  fprintf(stderr, "prediction failed\n");
 	  depth--;
@@ -698,6 +1607,8 @@ void UniformRandomSearch::DoUniformRandomPath() {
 
     i++;
   }
+
+  return (depth > 0);
 }
 
 
@@ -711,35 +1622,36 @@ HybridSearch::HybridSearch(const string& program, int max_iterations, int step_s
 HybridSearch::~HybridSearch() { }
 
 void HybridSearch::Run() {
-  SymbolicExecution ex;
+  ExecutionView ex;
 
   while (true) {
     // Execution on empty/random inputs.
-    RunProgram(vector<value_t>(), &ex);
+    if (!RunProgram(vector<value_t>(), &ex))
+      return;
     UpdateCoverage(ex);
 
     // Local searches at increasingly deeper execution points.
-    for (size_t pos = 0; pos < ex.path().constraints().size(); pos += step_size_) {
+    for (size_t pos = 0; pos < ex.num_constraints(); pos += step_size_) {
       RandomLocalSearch(&ex, pos, pos+step_size_);
     }
   }
 }
 
-void HybridSearch::RandomLocalSearch(SymbolicExecution *ex, size_t start, size_t end) {
+void HybridSearch::RandomLocalSearch(ExecutionView *ex, size_t start, size_t end) {
   for (int iters = 0; iters < 100; iters++) {
     if (!RandomStep(ex, start, end))
       break;
   }
 }
 
-bool HybridSearch::RandomStep(SymbolicExecution *ex, size_t start, size_t end) {
+bool HybridSearch::RandomStep(ExecutionView *ex, size_t start, size_t end) {
 
-  if (end > ex->path().constraints().size()) {
-    end = ex->path().constraints().size();
+  if (end > ex->num_constraints()) {
+    end = ex->num_constraints();
   }
   assert(start < end);
 
-  SymbolicExecution next_ex;
+  ExecutionView next_ex;
   vector<value_t> input;
 
   fprintf(stderr, "%zu-%zu\n", start, end);
@@ -758,9 +1670,10 @@ bool HybridSearch::RandomStep(SymbolicExecution *ex, size_t start, size_t end) {
     idxs.pop_back();
 
     if (SolveAtBranch(*ex, i, &input)) {
-      RunProgram(input, &next_ex);
+      if (!RunProgram(input, &next_ex))
+        return false;
       UpdateCoverage(next_ex);
-      if (CheckPrediction(*ex, next_ex, ex->path().constraints_idx()[i])) {
+      if (CheckPrediction(*ex, next_ex, ex->constraints_idx()[i])) {
 	ex->Swap(next_ex);
 	return true;
       }
@@ -782,12 +1695,13 @@ CfgBaselineSearch::~CfgBaselineSearch() { }
 
 
 void CfgBaselineSearch::Run() {
-  SymbolicExecution ex;
+  ExecutionView ex;
 
   while (true) {
     // Execution on empty/random inputs.
     fprintf(stderr, "RESET\n");
-    RunProgram(vector<value_t>(), &ex);
+    if (!RunProgram(vector<value_t>(), &ex))
+      return;
     UpdateCoverage(ex);
 
     while (DoSearch(5, 250, 0, ex)) {
@@ -799,12 +1713,12 @@ void CfgBaselineSearch::Run() {
 
 
 bool CfgBaselineSearch::DoSearch(int depth, int iters, int pos,
-				 const SymbolicExecution& prev_ex) {
+				 const ExecutionView& prev_ex) {
 
   // For each symbolic branch/constraint in the execution path, we will
   // compute a heuristic score, and then attempt to force the branches
   // in order of increasing score.
-  vector<ScoredBranch> scoredBranches(prev_ex.path().constraints().size() - pos);
+  vector<ScoredBranch> scoredBranches(prev_ex.num_constraints() - pos);
   for (size_t i = 0; i < scoredBranches.size(); i++) {
     scoredBranches[i].first = i + pos;
   }
@@ -814,8 +1728,8 @@ bool CfgBaselineSearch::DoSearch(int depth, int iters, int pos,
     map<branch_id_t,int> seen;
     for (size_t i = 0; i < scoredBranches.size(); i++) {
       size_t idx = scoredBranches[i].first;
-      size_t branch_idx = prev_ex.path().constraints_idx()[idx];
-      branch_id_t bid = paired_branch_[prev_ex.path().branches()[branch_idx]];
+      size_t branch_idx = prev_ex.constraints_idx()[idx];
+      branch_id_t bid = paired_branch_[prev_ex.branches()[branch_idx]];
       if (covered_[bid]) {
 	scoredBranches[i].second = 100000000 + seen[bid];
       } else {
@@ -827,18 +1741,21 @@ bool CfgBaselineSearch::DoSearch(int depth, int iters, int pos,
   stable_sort(scoredBranches.begin(), scoredBranches.end(), ScoredBranchComp());
 
   // Solve.
-  SymbolicExecution cur_ex;
+  SpeculationScope speculation(this, prev_ex);
+  ExecutionView cur_ex;
   vector<value_t> input;
   for (size_t i = 0; i < scoredBranches.size(); i++) {
     if (iters <= 0) {
       return false;
     }
 
+    SolveAhead(prev_ex, scoredBranches, i + 1, numeric_limits<int>::max());
     if (!SolveAtBranch(prev_ex, scoredBranches[i].first, &input)) {
       continue;
     }
 
-    RunProgram(input, &cur_ex);
+    if (!RunProgram(input, &cur_ex))
+      return false;
     iters--;
 
     if (UpdateCoverage(cur_ex, NULL)) {
@@ -855,10 +1772,13 @@ bool CfgBaselineSearch::DoSearch(int depth, int iters, int pos,
 //// CfgHeuristicSearch ////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
+const size_t CfgHeuristicSearch::kInfiniteDistance;
+
 CfgHeuristicSearch::CfgHeuristicSearch
 (const string& program, int max_iterations)
   : Search(program, max_iterations),
-    cfg_(max_branch_), cfg_rev_(max_branch_), dist_(max_branch_) {
+    cfg_(max_branch_), cfg_rev_(max_branch_), dist_(max_branch_),
+    dist_valid_(false), dist_affected_(max_branch_, false) {
 
   // Read in the CFG.
   ifstream in("cfg_branches", ios::in | ios::binary);
@@ -876,12 +1796,35 @@ CfgHeuristicSearch::CfgHeuristicSearch
   }
   in.close();
 
+  // Read in the function summaries, if process_cfg wrote any.
+  exit_dist_.assign(max_branch_, kInfiniteDistance);
+  ifstream summaries("cfg_summaries", ios::in | ios::binary);
+  if (summaries) {
+    size_t num_summaries = 0;
+    summaries.read((char*)&num_summaries, sizeof(num_summaries));
+    for (size_t i = 0; summaries && (i < num_summaries); i++) {
+      branch_id_t bid;
+      int exit_dist;
+      summaries.read((char*)&bid, sizeof(bid));
+      summaries.read((char*)&exit_dist, sizeof(exit_dist));
+      if (summaries && (bid >= 0) && (bid < max_branch_) && (exit_dist >= 0))
+        exit_dist_[bid] = min(static_cast<size_t>(exit_dist), kInfiniteDistance);
+    }
+    summaries.close();
+  }
+
   // Construct the reversed CFG.
   for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
     for (BranchIt j = cfg_[*i].begin(); j != cfg_[*i].end(); ++j) {
       cfg_rev_[*j].push_back(*i);
     }
   }
+
+  // Many branches of the same execution are solved in a row.
+  use_solver_session_ = true;
+
+  // The branch distances are updated from the newly covered branches.
+  log_new_coverage_ = true;
 }
 
 
@@ -889,16 +1832,17 @@ CfgHeuristicSearch::~CfgHeuristicSearch() { }
 
 
 void CfgHeuristicSearch::Run() {
-  set<branch_id_t> newly_covered_;
-  SymbolicExecution ex;
+  ExecutionView ex;
 
   while (true) {
     covered_.assign(max_branch_, false);
     num_covered_ = 0;
+    dist_valid_ = false;
 
     // Execution on empty/random inputs.
     fprintf(stderr, "RESET\n");
-    RunProgram(vector<value_t>(), &ex);
+    if (!RunProgram(vector<value_t>(), &ex))
+      return;
     if (UpdateCoverage(ex)) {
       UpdateBranchDistances();
       PrintStats();
@@ -936,7 +1880,93 @@ void CfgHeuristicSearch::PrintStats() {
 }
 
 
+// Covering a branch only removes it from the sources of the BFS (see
+// ComputeBranchDistances), so distances only grow.  Rather than repeat
+// the whole BFS, only the branches whose distances change are revisited
+// (as in the decremental BFS trees of Even and Shiloach):
+//
+//  1. Find the affected branches, in order of their old distances: each
+//     newly covered branch, and each branch whose successors one closer
+//     to an uncovered branch are all affected.
+//  2. Start each affected branch at the distance through its nearest
+//     unaffected successor, and then settle the affected branches in
+//     order of distance, relaxing only their affected predecessors.
+//
+// Each step examines only the affected branches and their neighbors.
 void CfgHeuristicSearch::UpdateBranchDistances() {
+  if (!dist_valid_) {
+    ComputeBranchDistances();
+    dist_valid_ = true;
+    newly_covered_.clear();
+    return;
+  }
+
+  vector<branch_id_t> affected;
+  for (BranchIt i = newly_covered_.begin(); i != newly_covered_.end(); ++i) {
+    if ((dist_[*i] == 0) && !dist_affected_[*i]) {
+      dist_affected_[*i] = true;
+      affected.push_back(*i);
+    }
+  }
+  newly_covered_.clear();
+
+  // (1) Branches are appended in order of old distance, so all affected
+  // branches at one distance are known before the next is examined.
+  for (size_t k = 0; k < affected.size(); k++) {
+    const size_t d = dist_[affected[k]];
+    const nbhr_list_t& preds = cfg_rev_[affected[k]];
+    for (BranchIt i = preds.begin(); i != preds.end(); ++i) {
+      if (dist_affected_[*i] || (dist_[*i] != d + 1))
+        continue;
+      bool supported = false;
+      for (BranchIt j = cfg_[*i].begin(); j != cfg_[*i].end(); ++j) {
+        if ((dist_[*j] == d) && !dist_affected_[*j]) {
+          supported = true;
+          break;
+        }
+      }
+      if (!supported) {
+        dist_affected_[*i] = true;
+        affected.push_back(*i);
+      }
+    }
+  }
+
+  // (2)
+  typedef pair<size_t,branch_id_t> entry_t;
+  priority_queue<entry_t, vector<entry_t>, greater<entry_t> > Q;
+  for (BranchIt i = affected.begin(); i != affected.end(); ++i) {
+    size_t d = kInfiniteDistance;
+    for (BranchIt j = cfg_[*i].begin(); j != cfg_[*i].end(); ++j) {
+      if (!dist_affected_[*j] && (dist_[*j] + 1 < d))
+        d = dist_[*j] + 1;
+    }
+    dist_[*i] = d;
+    if (d < kInfiniteDistance)
+      Q.push(make_pair(d, *i));
+  }
+
+  while (!Q.empty()) {
+    size_t d = Q.top().first;
+    branch_id_t i = Q.top().second;
+    Q.pop();
+    if (d != dist_[i])
+      continue;
+    for (BranchIt j = cfg_rev_[i].begin(); j != cfg_rev_[i].end(); ++j) {
+      if (dist_affected_[*j] && (d + 1 < dist_[*j])) {
+        dist_[*j] = d + 1;
+        Q.push(make_pair(d + 1, *j));
+      }
+    }
+  }
+
+  for (BranchIt i = affected.begin(); i != affected.end(); ++i) {
+    dist_affected_[*i] = false;
+  }
+}
+
+
+void CfgHeuristicSearch::ComputeBranchDistances() {
   // We run a BFS backward, starting simultaneously at all uncovered vertices.
   queue<branch_id_t> Q;
   for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
@@ -967,12 +1997,12 @@ bool CfgHeuristicSearch::DoSearch(int depth,
 				  int iters,
 				  int pos,
 				  int maxDist,
-				  const SymbolicExecution& prev_ex) {
+				  const ExecutionView& prev_ex) {
 
   fprintf(stderr, "DoSearch(%d, %d, %d, %zu)\n",
-	  depth, pos, maxDist, prev_ex.path().branches().size());
+	  depth, pos, maxDist, prev_ex.branches().size());
 
-  if (pos >= static_cast<int>(prev_ex.path().constraints().size()))
+  if (pos >= static_cast<int>(prev_ex.num_constraints()))
     return false;
 
   if (depth == 0)
@@ -982,20 +2012,24 @@ bool CfgHeuristicSearch::DoSearch(int depth,
   // For each symbolic branch/constraint in the execution path, we will
   // compute a heuristic score, and then attempt to force the branches
   // in order of increasing score.
-  vector<ScoredBranch> scoredBranches(prev_ex.path().constraints().size() - pos);
+  vector<ScoredBranch> scoredBranches(prev_ex.num_constraints() - pos);
   for (size_t i = 0; i < scoredBranches.size(); i++) {
     scoredBranches[i].first = i + pos;
   }
 
+  // The scores are distances in each branch's calling context.
+  vector<size_t> ret_dist;
+  ComputeReturnDistances(prev_ex.branches(), &ret_dist);
+
   { // Compute (and sort by) the scores.
     random_shuffle(scoredBranches.begin(), scoredBranches.end());
     map<branch_id_t,int> seen;
     for (size_t i = 0; i < scoredBranches.size(); i++) {
       size_t idx = scoredBranches[i].first;
-      size_t branch_idx = prev_ex.path().constraints_idx()[idx];
-      branch_id_t bid = paired_branch_[prev_ex.path().branches()[branch_idx]];
+      size_t branch_idx = prev_ex.constraints_idx()[idx];
+      branch_id_t bid = paired_branch_[prev_ex.branches()[branch_idx]];
 
-      scoredBranches[i].second = dist_[bid] + seen[bid];
+      scoredBranches[i].second = CflDistance(bid, ret_dist[branch_idx]) + seen[bid];
       seen[bid] += 1;
 
       /*
@@ -1011,24 +2045,30 @@ bool CfgHeuristicSearch::DoSearch(int depth,
   stable_sort(scoredBranches.begin(), scoredBranches.end(), ScoredBranchComp());
 
   // Solve.
-  SymbolicExecution cur_ex;
+  SpeculationScope speculation(this, prev_ex);
+  ExecutionView cur_ex;
   vector<value_t> input;
+  bool continued = false;
   for (size_t i = 0; i < scoredBranches.size(); i++) {
     if ((iters <= 0) || (scoredBranches[i].second > maxDist))
       return false;
 
     num_inner_solves_ ++;
 
+    SolveAhead(prev_ex, scoredBranches, i + 1, maxDist);
+
     if (!SolveAtBranch(prev_ex, scoredBranches[i].first, &input)) {
       num_inner_unsats_ ++;
       continue;
     }
 
-    RunProgram(input, &cur_ex);
+    if (!RunProgram(input, &cur_ex))
+      return false;
     iters--;
 
-    size_t b_idx = prev_ex.path().constraints_idx()[scoredBranches[i].first];
-    branch_id_t bid = paired_branch_[prev_ex.path().branches()[b_idx]];
+    size_t b_idx = prev_ex.constraints_idx()[scoredBranches[i].first];
+    branch_id_t bid = paired_branch_[prev_ex.branches()[b_idx]];
+    size_t dist = CflDistance(bid, ret_dist[b_idx]);
     set<branch_id_t> new_branches;
     bool found_new_branch = UpdateCoverage(cur_ex, &new_branches);
     bool prediction_failed = !CheckPrediction(prev_ex, cur_ex, b_idx);
@@ -1038,7 +2078,7 @@ bool CfgHeuristicSearch::DoSearch(int depth,
       fprintf(stderr, "Prediction failed.\n");
       fprintf(stderr, "Found new branch by forcing at "
 	              "distance %zu (%d) [lucky, pred failed].\n",
-	      dist_[bid], scoredBranches[i].second);
+	      dist, scoredBranches[i].second);
 
       // We got lucky, and can't really compute any further stats
       // because prediction failed.
@@ -1050,13 +2090,13 @@ bool CfgHeuristicSearch::DoSearch(int depth,
 
     if (found_new_branch && !prediction_failed) {
       fprintf(stderr, "Found new branch by forcing at distance %zu (%d).\n",
-	      dist_[bid], scoredBranches[i].second);
+	      dist, scoredBranches[i].second);
       size_t min_dist = MinCflDistance(b_idx, cur_ex, new_branches);
       // Check if we were lucky.
-      if (FindAlongCfg(b_idx, dist_[bid], cur_ex, new_branches)) {
+      if (min_dist <= dist) {
 	assert(min_dist <= dist_[bid]);
 	// A legitimate find -- return success.
-	if (dist_[bid] == 0) {
+	if (dist == 0) {
 	  num_inner_zero_successes_ ++;
 	} else {
 	  num_inner_nonzero_successes_ ++;
@@ -1065,9 +2105,12 @@ bool CfgHeuristicSearch::DoSearch(int depth,
 	return true;
       } else {
 	// We got lucky, but as long as there were no prediction failures,
-	// we'll finish the CFG search to see if that works, too.
-	assert(min_dist > dist_[bid]);
-	assert(dist_[bid] != 0);
+	// we'll finish the CFG search to see if that works, too.  (Distances
+	// are only updated between searches, so 'bid' can still be at
+	// distance 0 if an earlier lucky run covered it.)
+	assert(min_dist > dist);
+	assert((dist != 0) || continued);
+	continued = true;
 	num_inner_lucky_successes_ ++;
       }
     }
@@ -1082,7 +2125,7 @@ bool CfgHeuristicSearch::DoSearch(int depth,
 
     // If we reached here, then scoredBranches[i].second is greater than 0.
     num_top_solves_ ++;
-    if ((dist_[bid] > 0) &&
+    if ((dist > 0) &&
         SolveAlongCfg(b_idx, scoredBranches[i].second-1, cur_ex)) {
       num_top_solve_successes_ ++;
       PrintStats();
@@ -1107,9 +2150,9 @@ bool CfgHeuristicSearch::DoSearch(int depth,
 
 
 size_t CfgHeuristicSearch::MinCflDistance
-(size_t i, const SymbolicExecution& ex, const set<branch_id_t>& bs) {
+(size_t i, const ExecutionView& ex, const set<branch_id_t>& bs) {
 
-  const vector<branch_id_t>& p = ex.path().branches();
+  const vector<branch_id_t>& p = ex.branches();
 
   if (i >= p.size())
     return numeric_limits<size_t>::max();
@@ -1133,8 +2176,9 @@ size_t CfgHeuristicSearch::MinCflDistance
     } else if (*j == kCallId) {
       stack.push_back(cur_dist);
     } else if (*j == kReturnId) {
+      // Returning from the function of branch i costs nothing.
       if (stack.size() == 0)
-	break;
+	continue;
       cur_dist = stack.back();
       stack.pop_back();
     } else {
@@ -1147,70 +2191,31 @@ size_t CfgHeuristicSearch::MinCflDistance
   return min_dist;
 }
 
-bool CfgHeuristicSearch::FindAlongCfg(size_t i, unsigned int dist,
-				      const SymbolicExecution& ex,
-				      const set<branch_id_t>& bs) {
-
-  const vector<branch_id_t>& path = ex.path().branches();
-
-  if (i >= path.size())
-    return false;
-
-  branch_id_t bid = path[i];
-  if (bs.find(bid) != bs.end())
-    return true;
-
-  if (dist == 0)
-    return false;
-
-  // Compute the indices of all branches on the path that immediately
-  // follow the current branch (corresponding to the i-th constraint)
-  // in the CFG. For example, consider the path:
-  //     * ( ( ( 1 2 ) 4 ) ( 5 ( 6 7 ) ) 8 ) 9
-  // where '*' is the current branch.  The branches immediately
-  // following '*' are : 1, 4, 5, 8, and 9.
-  vector<size_t> idxs;
-  { size_t pos = i + 1;
-    CollectNextBranches(path, &pos, &idxs);
-  }
-
-  for (vector<size_t>::const_iterator j = idxs.begin(); j != idxs.end(); ++j) {
-    if (FindAlongCfg(*j, dist-1, ex, bs))
-      return true;
-  }
-
-  return false;
+bool CfgHeuristicSearch::SolveAlongCfg(size_t i, unsigned int max_dist,
+				       const ExecutionView& prev_ex) {
+  vector<size_t> ret_dist;
+  ComputeReturnDistances(prev_ex.branches(), &ret_dist);
+  return SolveAlongCfg(i, max_dist, prev_ex, ret_dist);
 }
 
-
 bool CfgHeuristicSearch::SolveAlongCfg(size_t i, unsigned int max_dist,
-				       const SymbolicExecution& prev_ex) {
+				       const ExecutionView& prev_ex,
+				       const vector<size_t>& ret_dist) {
   num_solves_ ++;
 
   fprintf(stderr, "SolveAlongCfg(%zu,%u)\n", i, max_dist);
-  SymbolicExecution cur_ex;
+  ExecutionView cur_ex;
   vector<value_t> input;
-  const vector<branch_id_t>& path = prev_ex.path().branches();
-
-  // Compute the indices of all branches on the path that immediately
-  // follow the current branch (corresponding to the i-th constraint)
-  // in the CFG. For example, consider the path:
-  //     * ( ( ( 1 2 ) 4 ) ( 5 ( 6 7 ) ) 8 ) 9
-  // where '*' is the current branch.  The branches immediately
-  // following '*' are : 1, 4, 5, 8, and 9.
+  const vector<branch_id_t>& path = prev_ex.branches();
+
   bool found_path = false;
   vector<size_t> idxs;
-  { size_t pos = i + 1;
-    CollectNextBranches(path, &pos, &idxs);
-    // fprintf(stderr, "Branches following %d:", path[i]);
-    for (size_t j = 0; j < idxs.size(); j++) {
-      // fprintf(stderr, " %d(%u,%u,%u)", path[idxs[j]], idxs[j],
-      //      dist_[path[idxs[j]]], dist_[paired_branch_[path[idxs[j]]]]);
-      if ((dist_[path[idxs[j]]] <= max_dist)
-	  || (dist_[paired_branch_[path[idxs[j]]]] <= max_dist))
-	found_path = true;
-    }
-    //fprintf(stderr, "\n");
+  CollectFollowingBranches(path, i, &idxs);
+  for (size_t j = 0; j < idxs.size(); j++) {
+    if ((CflDistance(path[idxs[j]], ret_dist[idxs[j]]) <= max_dist)
+        || (CflDistance(paired_branch_[path[idxs[j]]], ret_dist[idxs[j]])
+            <= max_dist))
+      found_path = true;
   }
 
   if (!found_path) {
@@ -1226,16 +2231,19 @@ bool CfgHeuristicSearch::SolveAlongCfg(size_t i, unsigned int max_dist,
   // recurse along each one with distance no greater than max_dist.
   random_shuffle(idxs.begin(), idxs.end());
   for (vector<size_t>::const_iterator j = idxs.begin(); j != idxs.end(); ++j) {
+    const size_t dist = CflDistance(path[*j], ret_dist[*j]);
+    const size_t paired_dist =
+      CflDistance(paired_branch_[path[*j]], ret_dist[*j]);
+
     // Skip if distance is wrong.
-    if ((dist_[path[*j]] > max_dist)
-	&& (dist_[paired_branch_[path[*j]]] > max_dist)) {
+    if ((dist > max_dist) && (paired_dist > max_dist)) {
       continue;
     }
 
-    if (dist_[path[*j]] <= max_dist) {
+    if (dist <= max_dist) {
       // No need to force, this branch is on a shortest path.
       num_solve_recurses_ ++;
-      if (SolveAlongCfg(*j, max_dist-1, prev_ex)) {
+      if (SolveAlongCfg(*j, max_dist-1, prev_ex, ret_dist)) {
 	num_solve_successes_ ++;
 	return true;
       }
@@ -1243,26 +2251,27 @@ bool CfgHeuristicSearch::SolveAlongCfg(size_t i, unsigned int max_dist,
 
     // Find the constraint corresponding to branch idxs[*j].
     vector<size_t>::const_iterator idx =
-      lower_bound(prev_ex.path().constraints_idx().begin(),
-		  prev_ex.path().constraints_idx().end(), *j);
-    if ((idx == prev_ex.path().constraints_idx().end()) || (*idx != *j)) {
+      lower_bound(prev_ex.constraints_idx().begin(),
+		  prev_ex.constraints_idx().end(), *j);
+    if ((idx == prev_ex.constraints_idx().end()) || (*idx != *j)) {
       continue;  // Branch is concrete.
     }
-    size_t c_idx = idx - prev_ex.path().constraints_idx().begin();
+    size_t c_idx = idx - prev_ex.constraints_idx().begin();
 
     if (all_concrete) {
       all_concrete = false;
       num_solve_all_concrete_ --;
     }
 
-    if(dist_[paired_branch_[path[*j]]] <= max_dist) {
+    if (paired_dist <= max_dist) {
       num_solve_sat_attempts_ ++;
       // The paired branch is along a shortest path, so force.
       if (!SolveAtBranch(prev_ex, c_idx, &input)) {
 	num_solve_unsats_ ++;
 	continue;
       }
-      RunProgram(input, &cur_ex);
+      if (!RunProgram(input, &cur_ex))
+	return false;
       if (UpdateCoverage(cur_ex)) {
 	num_solve_successes_ ++;
 	success_ex_.Swap(cur_ex);
@@ -1320,41 +2329,79 @@ void CfgHeuristicSearch::CollectNextBranches
     return;
   }
 
-  // Alternatively, if the sequence is followed by a return, collect the branches
-  // immediately following the return.
-  /*
-  if ((*pos < path.size()) && (path[*pos] == kReturnId)) {
-    (*pos)++;
-    CollectNextBranches(path, pos, idxs);
+}
+
+// Computes the indices of all branches on the path that immediately
+// follow branch i in the CFG, including (if its function returns before
+// any other branch) those following the return.  For example, consider
+// the path:
+//     * ( ( ( 1 2 ) 4 ) ( 5 ( 6 7 ) ) 8 ) 9
+// where '*' is branch i.  The branches immediately following '*' are:
+// 1, 4, 5, 8, and 9.
+void CfgHeuristicSearch::CollectFollowingBranches
+(const vector<branch_id_t>& path, size_t i, vector<size_t>* idxs) {
+  size_t pos = i + 1;
+  CollectNextBranches(path, &pos, idxs);
+  while ((pos < path.size()) && (path[pos] == kReturnId)) {
+    pos++;
+    CollectNextBranches(path, &pos, idxs);
+  }
+}
+
+
+// Walks the path backwards, keeping the distance to an uncovered branch
+// from the current point: through the next branch on the path or its
+// paired branch (via the CFG, or via the return of its function) or, for
+// the taken branch, along the rest of the path.  The distance at each
+// return is saved on a stack, as the return distance of the branches
+// of the function returning there.  (A function which never returns is
+// always at the end of the path, where the stack is still empty.)
+void CfgHeuristicSearch::ComputeReturnDistances
+(const vector<branch_id_t>& path, vector<size_t>* ret_dist) {
+  ret_dist->assign(path.size(), kInfiniteDistance);
+  vector<size_t> stack;
+  size_t cur_dist = kInfiniteDistance;
+  for (size_t j = path.size(); j-- > 0; ) {
+    if (path[j] == kReturnId) {
+      stack.push_back(cur_dist);
+    } else if (path[j] == kCallId) {
+      if (!stack.empty())
+        stack.pop_back();
+    } else if (path[j] >= 0) {
+      size_t r = stack.empty() ? kInfiniteDistance : stack.back();
+      (*ret_dist)[j] = r;
+      size_t d = min(cur_dist, CflDistance(path[j], r));
+      d = min(d, CflDistance(paired_branch_[path[j]], r));
+      cur_dist = min(d + 1, kInfiniteDistance);
+    }
   }
-  */
 }
 
 
-bool CfgHeuristicSearch::DoBoundedBFS(int i, int depth, const SymbolicExecution& prev_ex) {
+bool CfgHeuristicSearch::DoBoundedBFS(int i, int depth, const ExecutionView& prev_ex) {
   if (depth <= 0)
     return false;
 
   fprintf(stderr, "%d (%d: %d) (%d: %d)\n", depth,
-          i-1, prev_ex.path().branches()[prev_ex.path().constraints_idx()[i-1]],
-          i, prev_ex.path().branches()[prev_ex.path().constraints_idx()[i]]);
+          i-1, prev_ex.branches()[prev_ex.constraints_idx()[i-1]],
+          i, prev_ex.branches()[prev_ex.constraints_idx()[i]]);
 
-  SymbolicExecution cur_ex;
+  ExecutionView cur_ex;
   vector<value_t> input;
-  const vector<SymbolicPred*>& constraints = prev_ex.path().constraints();
-  for (size_t j = static_cast<size_t>(i); j < constraints.size(); j++) {
+  for (size_t j = static_cast<size_t>(i); j < prev_ex.num_constraints(); j++) {
     if (!SolveAtBranch(prev_ex, j, &input)) {
       continue;
     }
 
-    RunProgram(input, &cur_ex);
+    if (!RunProgram(input, &cur_ex))
+      return false;
     iters_left_--;
     if (UpdateCoverage(cur_ex)) {
       success_ex_.Swap(cur_ex);
       return true;
     }
 
-    if (!CheckPrediction(prev_ex, cur_ex, prev_ex.path().constraints_idx()[j])) {
+    if (!CheckPrediction(prev_ex, cur_ex, prev_ex.constraints_idx()[j])) {
       fprintf(stderr, "Prediction failed!\n");
       continue;
     }
@@ -11,10 +11,15 @@
 #ifndef RUN_CREST_CONCOLIC_SEARCH_H__
 #define RUN_CREST_CONCOLIC_SEARCH_H__
 
+#include <algorithm>
+#include <istream>
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 #include <ext/hash_map>
 #include <ext/hash_set>
+#include <sys/types.h>
 #include <time.h>
 
 /*
@@ -24,9 +29,16 @@
 */
 
 #include "base/basic_types.h"
+#include "base/execution_view.h"
 #include "base/symbolic_execution.h"
+#include "base/yices_solver.h"
+#include "run_crest/execution_tree.h"
+#include "run_crest/search_budget.h"
 
+using std::istream;
 using std::map;
+using std::pair;
+using std::string;
 using std::vector;
 using __gnu_cxx::hash_map;
 using __gnu_cxx::hash_set;
@@ -38,9 +50,55 @@ class Search {
   Search(const string& program, int max_iterations);
   virtual ~Search();
 
+  // Runs the search until it is done or its budget (see budget()) is
+  // exhausted.
   virtual void Run() = 0;
 
+  // Runs 'num_jobs' copies of this search in parallel, each in its own
+  // forked process with its own shared-memory slot for talking to the
+  // program under test.  The jobs share a single iteration count and a
+  // single coverage map, which is updated atomically.  The dfs and
+  // generational strategies split the search tree among the jobs (see
+  // OwnsInitialFlip); the others rely on their randomness, and on
+  // steering away from branches covered by any job.
+  void RunJobs(int num_jobs);
+
+  // Run the program under test as a fork server (see base/fork_server.h),
+  // rather than starting it from scratch on every iteration.
+  void set_use_fork_server(bool b) { use_fork_server_ = b; }
+
+  // Pass inputs and executions to/from the program under test through
+  // shared memory (see base/shm_transport.h), rather than through files.
+  void set_use_shm(bool b) { use_shm_ = b; }
+
+  // Periodically save the state of the search to the file "checkpoint"
+  // (see MaybeCheckpoint).
+  void set_checkpointing(bool b) { checkpointing_ = b; }
+
+  // Restores the state of the search from the file "checkpoint", so that
+  // Run() continues where the checkpointed search left off.
+  void ResumeOrDie();
+
+  // Solve up to 'n' of the next candidate branches ahead of time, in
+  // parallel (see SolveAhead).  Only the CFG strategies do so.
+  void set_solver_pool_size(size_t n) { solver_pool_.set_size(n); }
+
+  // Limits on the search, beyond its number of iterations.
+  SearchBudget* budget() { return &budget_; }
+
  protected:
+  // When running in parallel (see RunJobs), the index of this job and
+  // the number of jobs.  The systematic strategies split the search among
+  // the jobs by the constraint negated in the initial execution: job j
+  // explores the subtrees reached by negating constraints j, j+N, j+2N,
+  // and so on (see OwnsInitialFlip).
+  int job_index_;
+  int num_jobs_;
+
+  bool OwnsInitialFlip(size_t idx) const {
+    return (num_jobs_ <= 1) || (static_cast<int>(idx % num_jobs_) == job_index_);
+  }
+
   vector<branch_id_t> branches_;
   vector<branch_id_t> paired_branch_;
   vector<function_id_t> branch_function_;
@@ -50,6 +108,12 @@ class Search {
   unsigned int num_covered_;
   unsigned int total_num_covered_;
 
+  // If set, each branch newly marked in covered_ by UpdateCoverage or
+  // MergeSharedCoverage is also appended to newly_covered_, for
+  // strategies which maintain state derived from the coverage.
+  bool log_new_coverage_;
+  vector<branch_id_t> newly_covered_;
+
   vector<bool> reached_;
   vector<unsigned int> branch_count_;
   function_id_t max_function_;
@@ -60,34 +124,157 @@ class Search {
 
   typedef vector<branch_id_t>::const_iterator BranchIt;
 
-  bool SolveAtBranch(const SymbolicExecution& ex,
+  // If set, SolveAtBranch keeps one solver context alive across calls
+  // (see YicesSession).  Worthwhile for strategies whose consecutive
+  // queries share long prefixes of the same path.
+  bool use_solver_session_;
+  YicesSession solver_session_;
+
+  // Results of earlier solver queries, consulted by SolveAtBranch.
+  SolverCache solver_cache_;
+
+  // Queries being solved speculatively (see SolveAhead), keyed by
+  // execution and constraint index.  speculative_next_ holds, for each
+  // execution with queries, the position of the next candidate to
+  // consider.  (A nested search speculates on its own execution, and
+  // leaves those of the enclosing searches alone.)
+  SolverPool solver_pool_;
+  map<const ExecutionView*,size_t> speculative_next_;
+
+  // The paths explored so far (updated by RunProgram).  SolveAtBranch
+  // does not try to reach a path which is already in the tree, or which
+  // is known to be infeasible (for the same slice of constraints).
+  ExecutionTree exec_tree_;
+  unsigned int num_skipped_explored_;
+  unsigned int num_skipped_infeasible_;
+
+  // Timeouts of solver queries and of executions.
+  unsigned int num_query_timeouts_;
+  unsigned int num_exec_timeouts_;
+
+  void PrintSearchStats();
+
+  // Returns true once the search should stop -- i.e. once the iterations
+  // or the budget have run out.  SolveAtBranch and RunProgram then fail
+  // immediately, and each strategy unwinds as soon as it sees that.
+  bool Exhausted();
+
+  // Collects into 'slice' the indices of the constraints of 'ex' on which
+  // the branch_idx-th one depends (including itself).  Returns false if
+  // one of the others is identical to it, so that negating it is
+  // infeasible.
+  bool DependentConstraints(const ExecutionView& ex, size_t branch_idx,
+                            vector<size_t>* slice);
+
+  // Solves for an input which follows 'ex' up to its branch_idx-th
+  // constraint and then negates it.  Only the constraints in that
+  // constraint's slice are decoded from the trace.
+  bool SolveAtBranch(const ExecutionView& ex,
 		     size_t branch_idx,
 		     vector<value_t>* input);
 
-  bool CheckPrediction(const SymbolicExecution& old_ex,
-		       const SymbolicExecution& new_ex,
+  // Starts solving, in solver_pool_, the candidates (constraint index,
+  // score) in 'branches' from position 'next' on -- up to a score of
+  // 'max_score', and as many as the pool has room for -- so that a later
+  // SolveAtBranch on one of them only has to collect the result.  A
+  // strategy calls this before each SolveAtBranch on a scored list of
+  // candidates, so that the solver works ahead while the program runs.
+  void SolveAhead(const ExecutionView& ex,
+                  const vector< pair<size_t,int> >& branches,
+                  size_t next, int max_score);
+
+  // Discards the speculative queries on 'ex'.
+  void CancelSpeculation(const ExecutionView& ex);
+
+  // Cancels the speculative queries on an execution when it goes out of
+  // scope -- i.e. at the end of a strategy's pass over the execution.
+  class SpeculationScope {
+   public:
+    SpeculationScope(Search* search, const ExecutionView& ex)
+      : search_(search), ex_(ex) { }
+    ~SpeculationScope() { search_->CancelSpeculation(ex_); }
+   private:
+    Search* search_;
+    const ExecutionView& ex_;
+  };
+
+  bool CheckPrediction(const ExecutionView& old_ex,
+		       const ExecutionView& new_ex,
 		       size_t branch_idx);
 
-  void RunProgram(const vector<value_t>& inputs, SymbolicExecution* ex);
-  bool UpdateCoverage(const SymbolicExecution& ex);
-  bool UpdateCoverage(const SymbolicExecution& ex,
+  // Runs the program on 'inputs', returning false (without running it)
+  // if the search is exhausted.  An execution which times out is treated
+  // as an empty one.  The execution is read into 'view' (see
+  // base/execution_view.h), detached so that it outlives the next run.
+  bool RunProgram(const vector<value_t>& inputs, ExecutionView* view);
+  bool UpdateCoverage(const ExecutionView& ex);
+  bool UpdateCoverage(const ExecutionView& ex,
+		      set<branch_id_t>* new_branches);
+  bool UpdateCoverage(const vector<branch_id_t>& branches,
 		      set<branch_id_t>* new_branches);
+  void MergeSharedCoverage();
 
   void RandomInput(const map<var_t,type_t>& vars, vector<value_t>* input);
 
+  // Checkpointing.  A strategy with state of its own saves and restores
+  // it in SaveState and LoadState, and calls MaybeCheckpoint at points in
+  // its search where that state is consistent -- with 'finished' once it
+  // is done or exhausted.  (Other strategies are checkpointed by
+  // RunProgram, and simply restart on resume with the coverage and
+  // explored paths restored.)
+  bool resumed_;
+  bool checkpoint_in_run_program_;
+  void MaybeCheckpoint(bool finished = false);
+  virtual void SaveState(string* s) const { }
+  virtual bool LoadState(istream& in) { return true; }
+
  private:
   const string program_;
   const int max_iters_; 
   int num_iters_;
+  SearchBudget budget_;
+
+  // State shared by all jobs when running in parallel (see RunJobs), in a
+  // shared anonymous mapping.  NULL when running a single search.
+  struct SharedState {
+    int num_iters;
+    unsigned int total_num_covered;
+    unsigned char total_covered[1];  // Actually max_branch_ entries.
+  };
+  SharedState* shared_;
+  unsigned int last_shared_num_covered_;
 
   /*
   struct sockaddr_un sock_;
   int sockd_;
   */
 
+  // Fork server state.
+  bool use_fork_server_;
+  pid_t fork_server_pid_;
+  int fork_server_ctrl_fd_;
+  int fork_server_status_fd_;
+
+  // Shared-memory transport state.
+  bool use_shm_;
+  int input_fd_;
+  int execution_fd_;
+
+  // Checkpointing state.
+  bool checkpointing_;
+  time_t last_checkpoint_time_;
+  int last_checkpoint_iters_;
+
+  void WriteCheckpointOrDie();
+
   void WriteInputToFileOrDie(const string& file, const vector<value_t>& input);
   void WriteCoverageToFileOrDie(const string& file);
-  void LaunchProgram(const vector<value_t>& inputs);
+  void CreateShmOrDie();
+  void WriteInputToShmOrDie(const vector<value_t>& input);
+  bool LaunchProgram(const vector<value_t>& inputs);
+  bool RunProgramWithTimeoutOrDie(double timeout);
+  void StartForkServerOrDie();
+  bool RunForkServerChildOrDie();
 };
 
 
@@ -100,10 +287,74 @@ class BoundedDepthFirstSearch : public Search {
 
   virtual void Run();
 
+ protected:
+  virtual void SaveState(string* s) const;
+  virtual bool LoadState(istream& in);
+
  private:
   int max_depth_;
 
-  void DFS(size_t pos, int depth, SymbolicExecution& prev_ex);
+  // The DFS is run with an explicit stack (so that it can be saved and
+  // restored), with one frame per execution being expanded.
+  struct Frame {
+    ExecutionView* ex;
+    size_t pos;  // Next constraint to try to negate.
+    int depth;   // Remaining depth budget.
+  };
+  vector<Frame> stack_;
+
+  void DFS();
+  void ClearStack();
+};
+
+
+// A generational search (as in SAGE).  Each execution is expanded by
+// negating, in one pass, every one of its constraints past its bound --
+// the position at which it was itself generated.  The resulting children
+// are run, scored by the number of new branches they cover, and queued,
+// and the highest-scoring execution in the queue is expanded next.
+class GenerationalSearch : public Search {
+ public:
+  GenerationalSearch(const string& program, int max_iterations);
+  virtual ~GenerationalSearch();
+
+  virtual void Run();
+
+ protected:
+  virtual void SaveState(string* s) const;
+  virtual bool LoadState(istream& in);
+
+ private:
+  struct Child {
+    ExecutionView* ex;
+    size_t bound;
+    unsigned int score;
+    unsigned int seq;  // For breaking ties in order of generation.
+  };
+
+  struct ChildLess {
+    bool operator()(const Child& a, const Child& b) const {
+      if (a.score != b.score)
+        return (a.score < b.score);
+      return (a.seq > b.seq);
+    }
+  };
+
+  // A heap of the executions waiting to be expanded.  Each holds a copy
+  // of its trace, so at most kMaxQueued are kept: past that, the
+  // lowest-scoring (and, among those, newest) child is dropped.
+  static const size_t kMaxQueued = 4096;
+  vector<Child> queue_;
+  unsigned int num_children_;
+
+  // Inputs (with their bounds) solved for by the last expansion but not
+  // yet run, in reverse order.
+  vector< pair<size_t, vector<value_t> > > pending_;
+
+  void Enqueue(ExecutionView* ex, size_t bound, unsigned int score);
+  // Solves for the children of 'ex' (see pending_).  For the 'initial'
+  // execution, only the children this job owns (see OwnsInitialFlip).
+  void Expand(const ExecutionView& ex, size_t bound, bool initial);
 };
 
 
@@ -130,7 +381,7 @@ class RandomInputSearch : public Search {
   virtual void Run();
   
  private:
-  SymbolicExecution ex_;
+  ExecutionView view_;
 };
 
 
@@ -142,10 +393,10 @@ class RandomSearch : public Search {
   virtual void Run();
 
  private:
-  SymbolicExecution ex_;
+  ExecutionView ex_;
 
   void SolveUncoveredBranches(size_t i, int depth,
-                              const SymbolicExecution& prev_ex);
+                              const ExecutionView& prev_ex);
 
   bool SolveRandomBranch(vector<value_t>* next_input, size_t* idx);
 };
@@ -159,12 +410,12 @@ class UniformRandomSearch : public Search {
   virtual void Run();
 
  private:
-  SymbolicExecution prev_ex_;
-  SymbolicExecution cur_ex_;
+  ExecutionView prev_ex_;
+  ExecutionView cur_ex_;
 
   size_t max_depth_;
 
-  void DoUniformRandomPath();
+  bool DoUniformRandomPath();
 };
 
 
@@ -179,8 +430,8 @@ class HybridSearch : public Search {
   virtual void Run();
 
  private:
-  void RandomLocalSearch(SymbolicExecution* ex, size_t start, size_t end);
-  bool RandomStep(SymbolicExecution* ex, size_t start, size_t end);
+  void RandomLocalSearch(ExecutionView* ex, size_t start, size_t end);
+  bool RandomStep(ExecutionView* ex, size_t start, size_t end);
 
   int step_size_;
 };
@@ -210,9 +461,9 @@ class CfgBaselineSearch : public Search {
   virtual void Run();
 
  private:
-  SymbolicExecution success_ex_;
+  ExecutionView success_ex_;
 
-  bool DoSearch(int depth, int iters, int pos, const SymbolicExecution& prev_ex);
+  bool DoSearch(int depth, int iters, int pos, const ExecutionView& prev_ex);
 };
 
 
@@ -227,13 +478,27 @@ class CfgHeuristicSearch : public Search {
   typedef vector<branch_id_t> nbhr_list_t;
   vector<nbhr_list_t> cfg_;
   vector<nbhr_list_t> cfg_rev_;
+
+  // The distance in cfg_ from each branch to the nearest uncovered
+  // branch (capped at kInfiniteDistance), maintained decrementally as
+  // branches are covered -- see UpdateBranchDistances.
   vector<size_t> dist_;
+  bool dist_valid_;  // False after covered_ is reset.
+  vector<bool> dist_affected_;  // Scratch space for UpdateBranchDistances.
+
+  // The distance from each branch to the return of its function (from
+  // the function summaries written by process_cfg, if any), so that the
+  // distance through the callers on a path can be found without walking
+  // the path -- see ComputeReturnDistances.  (No entry-to-branch
+  // summaries are needed: cfg_ has an edge from each call to the entry
+  // of the callee, so dist_ already counts paths into callees.)
+  vector<size_t> exit_dist_;
 
   static const size_t kInfiniteDistance = 10000;
 
   int iters_left_;
 
-  SymbolicExecution success_ex_;
+  ExecutionView success_ex_;
 
   // Stats.
   unsigned num_inner_solves_;
@@ -258,23 +523,39 @@ class CfgHeuristicSearch : public Search {
   unsigned num_solve_no_paths_;
 
   void UpdateBranchDistances();
+  void ComputeBranchDistances();
   void PrintStats();
-  bool DoSearch(int depth, int iters, int pos, int maxDist, const SymbolicExecution& prev_ex);
-  bool DoBoundedBFS(int i, int depth, const SymbolicExecution& prev_ex);
+  bool DoSearch(int depth, int iters, int pos, int maxDist, const ExecutionView& prev_ex);
+  bool DoBoundedBFS(int i, int depth, const ExecutionView& prev_ex);
   void SkipUntilReturn(const vector<branch_id_t> path, size_t* pos);
 
-  bool FindAlongCfg(size_t i, unsigned int dist,
-		    const SymbolicExecution& ex,
-		    const set<branch_id_t>& bs);
-
   bool SolveAlongCfg(size_t i, unsigned int max_dist,
-		     const SymbolicExecution& prev_ex);
+		     const ExecutionView& prev_ex);
+  // As above, with the return distances (see below) of prev_ex, which
+  // are computed once per execution.
+  bool SolveAlongCfg(size_t i, unsigned int max_dist,
+		     const ExecutionView& prev_ex,
+		     const vector<size_t>& ret_dist);
 
   void CollectNextBranches(const vector<branch_id_t>& path,
 			   size_t* pos, vector<size_t>* idxs);
+  void CollectFollowingBranches(const vector<branch_id_t>& path,
+				size_t i, vector<size_t>* idxs);
+
+  // Sets (*ret_dist)[j], for each branch j on 'path', to the distance to
+  // an uncovered branch from the point to which j's function returns.
+  void ComputeReturnDistances(const vector<branch_id_t>& path,
+			      vector<size_t>* ret_dist);
+
+  // The distance from branch 'b' to an uncovered branch, in a calling
+  // context whose return distance (see above) is 'ret_dist'.
+  size_t CflDistance(branch_id_t b, size_t ret_dist) const {
+    return std::min(dist_[b],
+                    std::min(exit_dist_[b] + ret_dist, kInfiniteDistance));
+  }
 
   size_t MinCflDistance(size_t i,
-			const SymbolicExecution& ex,
+			const ExecutionView& ex,
 			const set<branch_id_t>& bs);
 };
 
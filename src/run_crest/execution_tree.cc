@@ -0,0 +1,231 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <assert.h>
+
+#include "run_crest/execution_tree.h"
+
+namespace crest {
+
+const unsigned int ExecutionTree::kMaxNodes;
+const unsigned int ExecutionTree::kNone;
+
+ExecutionTree::ExecutionTree() : paired_(NULL) {
+  Clear();
+}
+
+
+void ExecutionTree::Clear() {
+  Node root;
+  root.bid = 0;
+  root.infeasible = false;
+  root.complete = false;
+  root.slice_hash = 0;
+  root.first_child = kNone;
+  root.next_sibling = kNone;
+  nodes_.assign(1, root);
+  free_ = kNone;
+  num_free_ = 0;
+}
+
+
+unsigned int ExecutionTree::FindChild(unsigned int node, branch_id_t bid) const {
+  for (unsigned int c = nodes_[node].first_child; c != kNone;
+       c = nodes_[c].next_sibling) {
+    if (nodes_[c].bid == bid)
+      return c;
+  }
+  return kNone;
+}
+
+
+unsigned int ExecutionTree::AddChild(unsigned int node, branch_id_t bid) {
+  unsigned int c = FindChild(node, bid);
+  if (c != kNone)
+    return c;
+
+  Node child;
+  child.bid = bid;
+  child.infeasible = false;
+  child.complete = false;
+  child.slice_hash = 0;
+  child.first_child = kNone;
+  child.next_sibling = nodes_[node].first_child;
+  if (free_ != kNone) {
+    c = free_;
+    free_ = nodes_[c].next_sibling;
+    num_free_--;
+    nodes_[c] = child;
+  } else {
+    // kMaxNodes (checked by Insert) keeps the indices far from kNone.
+    assert(nodes_.size() < kNone);
+    c = nodes_.size();
+    nodes_.push_back(child);
+  }
+  nodes_[node].first_child = c;
+  return c;
+}
+
+
+void ExecutionTree::FindPrefix(const ExecutionView& ex, size_t len,
+                               vector<unsigned int>* nodes) const {
+  const vector<branch_id_t>& branches = ex.branches();
+  const vector<size_t>& idx = ex.constraints_idx();
+  nodes->assign(1, 0);
+  for (size_t i = 0; (i < len) && !nodes_[nodes->back()].complete; i++) {
+    unsigned int c = FindChild(nodes->back(), branches[idx[i]]);
+    if (c == kNone)
+      return;
+    nodes->push_back(c);
+  }
+}
+
+
+bool ExecutionTree::IsComplete(unsigned int node) const {
+  const Node& n = nodes_[node];
+  if (n.complete)
+    return true;
+  if (!paired_ || (n.first_child == kNone))
+    return false;
+  // Every child must be explored, and so must its paired branch.  (An
+  // infeasible child is not done: it is only known to be infeasible for
+  // one slice, and a later execution may reach it with another.)
+  for (unsigned int c = n.first_child; c != kNone; c = nodes_[c].next_sibling) {
+    if (!nodes_[c].complete)
+      return false;
+    const branch_id_t bid = nodes_[c].bid;
+    if ((static_cast<size_t>(bid) >= paired_->size())
+        || (FindChild(node, (*paired_)[bid]) == kNone))
+      return false;
+  }
+  return true;
+}
+
+
+void ExecutionTree::FreeChildren(unsigned int node) {
+  vector<unsigned int> stack(1, nodes_[node].first_child);
+  nodes_[node].first_child = kNone;
+  while (!stack.empty()) {
+    unsigned int c = stack.back();
+    stack.pop_back();
+    if (c == kNone)
+      continue;
+    stack.push_back(nodes_[c].next_sibling);
+    stack.push_back(nodes_[c].first_child);
+    nodes_[c].next_sibling = free_;
+    free_ = c;
+    num_free_++;
+  }
+}
+
+
+void ExecutionTree::Collapse(const vector<unsigned int>& nodes) {
+  for (size_t i = nodes.size(); i > 0; i--) {
+    const unsigned int node = nodes[i-1];
+    if (!IsComplete(node))
+      return;
+    FreeChildren(node);
+    nodes_[node].complete = true;
+  }
+}
+
+
+void ExecutionTree::Insert(const SymbolicPath& path) {
+  Insert(path.branches(), path.constraints_idx());
+}
+
+
+void ExecutionTree::Insert(const vector<branch_id_t>& branches,
+                           const vector<size_t>& idx) {
+  if (num_nodes() + idx.size() > kMaxNodes) {
+    Clear();
+  }
+
+  vector<unsigned int> nodes(1, 0);
+  for (size_t i = 0; i < idx.size(); i++) {
+    if (nodes_[nodes.back()].complete)
+      return;
+    nodes.push_back(AddChild(nodes.back(), branches[idx[i]]));
+    // The path was just followed, so it is certainly feasible.
+    nodes_[nodes.back()].infeasible = false;
+  }
+
+  // Nothing follows the end of the path.
+  if (nodes_[nodes.back()].first_child == kNone) {
+    nodes_[nodes.back()].complete = true;
+  }
+  Collapse(nodes);
+}
+
+
+bool ExecutionTree::IsKnown(const ExecutionView& ex, size_t idx,
+                            branch_id_t bid, bool* infeasible,
+                            unsigned int* slice_hash) const {
+  vector<unsigned int> nodes;
+  FindPrefix(ex, idx, &nodes);
+  const Node& n = nodes_[nodes.back()];
+  if (n.complete) {
+    // Everything below has been explored.
+    *infeasible = false;
+    return true;
+  }
+  if (nodes.size() <= idx)
+    return false;
+  unsigned int child = FindChild(nodes.back(), bid);
+  if (child == kNone)
+    return false;
+  *infeasible = nodes_[child].infeasible;
+  *slice_hash = nodes_[child].slice_hash;
+  return true;
+}
+
+
+void ExecutionTree::MarkInfeasible(const ExecutionView& ex, size_t idx,
+                                   branch_id_t bid, unsigned int slice_hash) {
+  vector<unsigned int> nodes;
+  FindPrefix(ex, idx, &nodes);
+  if ((nodes.size() <= idx) || nodes_[nodes.back()].complete)
+    return;
+  unsigned int child = FindChild(nodes.back(), bid);
+  if ((child != kNone) && !nodes_[child].infeasible)
+    return;
+  if (child == kNone) {
+    if (num_nodes() >= kMaxNodes)
+      return;
+    child = AddChild(nodes.back(), bid);
+  }
+  nodes_[child].infeasible = true;
+  nodes_[child].slice_hash = slice_hash;
+  Collapse(nodes);
+}
+
+
+void ExecutionTree::Serialize(string* s) const {
+  size_t len = nodes_.size();
+  s->append((char*)&len, sizeof(len));
+  s->append((char*)&free_, sizeof(free_));
+  s->append((char*)&num_free_, sizeof(num_free_));
+  s->append((char*)&nodes_.front(), len * sizeof(Node));
+}
+
+
+bool ExecutionTree::Parse(istream& s) {
+  size_t len;
+  s.read((char*)&len, sizeof(len));
+  s.read((char*)&free_, sizeof(free_));
+  s.read((char*)&num_free_, sizeof(num_free_));
+  if (s.fail() || (len == 0) || (len > kMaxNodes + 1))
+    return false;
+  nodes_.resize(len);
+  s.read((char*)&nodes_.front(), len * sizeof(Node));
+  return !s.fail();
+}
+
+}  // namespace crest
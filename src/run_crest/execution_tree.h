@@ -0,0 +1,123 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef RUN_CREST_EXECUTION_TREE_H__
+#define RUN_CREST_EXECUTION_TREE_H__
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/execution_view.h"
+#include "base/symbolic_path.h"
+
+using std::istream;
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// A trie of the paths explored so far, over the branches which carry a
+// symbolic constraint (see SymbolicPath::constraints_idx).
+//
+// Each node is one such branch, reached by the sequence of branches
+// from the root.  A node may also record that the path to it is known
+// to be infeasible (i.e. the solver found the constraints of some slice
+// unsatisfiable -- see MarkInfeasible).
+//
+// The trie is kept bounded in two ways.  A node whose subtree is fully
+// explored -- the last branch of an explored path, or a node with both
+// directions of the next branch explored -- is collapsed: its children
+// are freed, and every path through it counts as explored.  (A node
+// with an infeasible child is never collapsed, as the mark only holds
+// for one slice.)  And if the trie still grows past kMaxNodes, it is
+// cleared.
+class ExecutionTree {
+ public:
+  ExecutionTree();
+
+  // The pairing of branches (see Search::paired_branch_), needed to
+  // collapse nodes.  Must outlive the tree.
+  void set_paired_branches(const vector<branch_id_t>* paired) {
+    paired_ = paired;
+  }
+
+  // Records the path followed by an execution.
+  void Insert(const SymbolicPath& path);
+  void Insert(const vector<branch_id_t>& branches,
+              const vector<size_t>& constraints_idx);
+
+  // Returns true if the path which follows the first 'idx' constrained
+  // branches of execution 'ex' and then takes branch 'bid' has already been
+  // explored, or is known to be infeasible.  In the latter case, sets
+  // *infeasible, and *slice_hash to the hash passed to MarkInfeasible.
+  bool IsKnown(const ExecutionView& ex, size_t idx, branch_id_t bid,
+               bool* infeasible, unsigned int* slice_hash) const;
+
+  // Records that the path which follows the first 'idx' constrained
+  // branches of 'ex' and then takes branch 'bid' is infeasible, given
+  // the slice of constraints with hash 'slice_hash'.  (The same branches
+  // may carry different constraints, when some operands were concretized,
+  // so the caller only trusts the mark for a slice with the same hash.)
+  void MarkInfeasible(const ExecutionView& ex, size_t idx, branch_id_t bid,
+                      unsigned int slice_hash);
+
+  // The number of nodes in use.
+  size_t num_nodes() const { return nodes_.size() - num_free_; }
+
+  void Serialize(string* s) const;
+  bool Parse(istream& s);
+
+  static const unsigned int kMaxNodes = 1 << 24;
+
+ private:
+  static const unsigned int kNone = ~0u;
+
+  struct Node {
+    branch_id_t bid;
+    bool infeasible;
+    bool complete;            // The subtree is fully explored (and freed).
+    unsigned int slice_hash;  // If infeasible.
+    unsigned int first_child;
+    unsigned int next_sibling;  // Also links the free list.
+  };
+
+  // nodes_[0] is the root, which corresponds to no branch.
+  vector<Node> nodes_;
+  unsigned int free_;
+  size_t num_free_;
+
+  const vector<branch_id_t>* paired_;
+
+  void Clear();
+
+  // Returns the child of 'node' for branch 'bid', or kNone if none.
+  unsigned int FindChild(unsigned int node, branch_id_t bid) const;
+
+  // Returns the child of 'node' for branch 'bid', adding it if needed.
+  unsigned int AddChild(unsigned int node, branch_id_t bid);
+
+  // Sets 'nodes' to the root and then the nodes for the first 'len'
+  // constrained branches of 'ex', stopping early at a missing node or
+  // at a complete one.
+  void FindPrefix(const ExecutionView& ex, size_t len,
+                  vector<unsigned int>* nodes) const;
+
+  // Collapses the deepest of 'nodes' (a path from the root) and then its
+  // ancestors, for as long as they are complete.
+  void Collapse(const vector<unsigned int>& nodes);
+  bool IsComplete(unsigned int node) const;
+  void FreeChildren(unsigned int node);
+};
+
+}  // namespace crest
+
+#endif  // RUN_CREST_EXECUTION_TREE_H__
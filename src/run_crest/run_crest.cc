@@ -10,19 +10,30 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
+#include <algorithm>
+#include <vector>
 
+#include "base/event_buffer.h"
 #include "run_crest/concolic_search.h"
 
+using std::max;
+using std::vector;
+
 int main(int argc, char* argv[]) {
   if (argc < 4) {
     fprintf(stderr,
             "Syntax: run_crest <program> "
             "<number of iterations> "
-            "-<strategy> [strategy options]\n");
+            "-<strategy> [strategy options] [-fork_server] [-shm] [-batch_events] "
+            "[-jobs N] [-solver_pool N] "
+            "[-checkpoint | -resume]\n"
+            "         [-time_limit SECS] [-solver_time_limit SECS] "
+            "[-query_timeout SECS] [-exec_timeout SECS]\n");
     fprintf(stderr,
             "  Strategies include: "
-            "dfs, cfg, random, uniform_random, random_input \n");
+            "dfs, generational, cfg, random, uniform_random, random_input \n");
     return 1;
   }
 
@@ -30,6 +41,50 @@ int main(int argc, char* argv[]) {
   int num_iters = atoi(argv[2]);
   string search_type = argv[3];
 
+  // Separate the general options from the strategy options.
+  bool use_fork_server = false;
+  bool use_shm = false;
+  int num_jobs = 1;
+  int solver_pool_size = 0;
+  bool checkpoint = false;
+  bool resume = false;
+  double time_limit = 0, solver_time_limit = 0;
+  double query_timeout = 0, exec_timeout = 0;
+  vector<char*> strategy_args;
+  for (int i = 4; i < argc; i++) {
+    if (string(argv[i]) == "-fork_server") {
+      use_fork_server = true;
+    } else if (string(argv[i]) == "-shm") {
+      use_shm = true;
+    } else if (string(argv[i]) == "-batch_events") {
+      // Inherited by every run of the program.
+      setenv(crest::kBatchEventsEnv, "1", 1);
+    } else if ((string(argv[i]) == "-jobs") && (i + 1 < argc)) {
+      num_jobs = atoi(argv[++i]);
+    } else if ((string(argv[i]) == "-solver_pool") && (i + 1 < argc)) {
+      solver_pool_size = atoi(argv[++i]);
+    } else if (string(argv[i]) == "-checkpoint") {
+      checkpoint = true;
+    } else if (string(argv[i]) == "-resume") {
+      checkpoint = resume = true;
+    } else if ((string(argv[i]) == "-time_limit") && (i + 1 < argc)) {
+      time_limit = atof(argv[++i]);
+    } else if ((string(argv[i]) == "-solver_time_limit") && (i + 1 < argc)) {
+      solver_time_limit = atof(argv[++i]);
+    } else if ((string(argv[i]) == "-query_timeout") && (i + 1 < argc)) {
+      query_timeout = atof(argv[++i]);
+    } else if ((string(argv[i]) == "-exec_timeout") && (i + 1 < argc)) {
+      exec_timeout = atof(argv[++i]);
+    } else {
+      strategy_args.push_back(argv[i]);
+    }
+  }
+
+  if (checkpoint && (num_jobs > 1)) {
+    fprintf(stderr, "Checkpointing is not supported with -jobs.\n");
+    return 1;
+  }
+
   // Initialize the random number generator.
   struct timeval tv;
   gettimeofday(&tv, NULL);
@@ -41,11 +96,14 @@ int main(int argc, char* argv[]) {
   } else if (search_type == "-random_input") {
     strategy = new crest::RandomInputSearch(prog, num_iters);
   } else if (search_type == "-dfs") {
-    if (argc == 4) {
+    if (strategy_args.empty()) {
       strategy = new crest::BoundedDepthFirstSearch(prog, num_iters, 1000000);
     } else {
-      strategy = new crest::BoundedDepthFirstSearch(prog, num_iters, atoi(argv[4]));
+      strategy = new crest::BoundedDepthFirstSearch(prog, num_iters,
+                                                    atoi(strategy_args[0]));
     }
+  } else if (search_type == "-generational") {
+    strategy = new crest::GenerationalSearch(prog, num_iters);
   } else if (search_type == "-cfg") {
     strategy = new crest::CfgHeuristicSearch(prog, num_iters);
   } else if (search_type == "-cfg_baseline") {
@@ -53,17 +111,33 @@ int main(int argc, char* argv[]) {
   } else if (search_type == "-hybrid") {
     strategy = new crest::HybridSearch(prog, num_iters, 100);
   } else if (search_type == "-uniform_random") {
-    if (argc == 4) {
+    if (strategy_args.empty()) {
       strategy = new crest::UniformRandomSearch(prog, num_iters, 100000000);
     } else {
-      strategy = new crest::UniformRandomSearch(prog, num_iters, atoi(argv[4]));
+      strategy = new crest::UniformRandomSearch(prog, num_iters,
+                                                atoi(strategy_args[0]));
     }
   } else {
     fprintf(stderr, "Unknown search strategy: %s\n", search_type.c_str());
     return 1;
   }
 
-  strategy->Run();
+  strategy->set_use_fork_server(use_fork_server);
+  strategy->set_use_shm(use_shm);
+  strategy->set_checkpointing(checkpoint);
+  strategy->set_solver_pool_size(max(solver_pool_size, 0));
+  strategy->budget()->set_max_time(time_limit);
+  strategy->budget()->set_max_solver_time(solver_time_limit);
+  strategy->budget()->set_query_timeout(query_timeout);
+  strategy->budget()->set_exec_timeout(exec_timeout);
+  if (resume) {
+    strategy->ResumeOrDie();
+  }
+  if (num_jobs > 1) {
+    strategy->RunJobs(num_jobs);
+  } else {
+    strategy->Run();
+  }
 
   delete strategy;
   return 0;
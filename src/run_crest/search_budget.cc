@@ -0,0 +1,61 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#include <algorithm>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "run_crest/search_budget.h"
+
+using std::max;
+
+namespace crest {
+
+SearchBudget::SearchBudget()
+  : max_time_(0), max_solver_time_(0), query_timeout_(0), exec_timeout_(0),
+    solver_time_(0), reason_(NULL) {
+  start_ = Now();
+}
+
+
+void SearchBudget::Start(double elapsed) {
+  start_ = Now() - elapsed;
+}
+
+
+double SearchBudget::ExecTimeout() const {
+  double timeout = exec_timeout_;
+  if (max_time_ > 0) {
+    double remaining = max(max_time_ - elapsed(), 0.001);
+    if ((timeout <= 0) || (remaining < timeout))
+      timeout = remaining;
+  }
+  return timeout;
+}
+
+
+double SearchBudget::Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1e6);
+}
+
+
+bool SearchBudget::CheckLimits() {
+  if ((max_time_ > 0) && (elapsed() >= max_time_)) {
+    Exhaust("time limit");
+  } else if ((max_solver_time_ > 0) && (solver_time_ >= max_solver_time_)) {
+    Exhaust("solver time limit");
+  }
+  return (reason_ != NULL);
+}
+
+}  // namespace crest
@@ -0,0 +1,89 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef RUN_CREST_SEARCH_BUDGET_H__
+#define RUN_CREST_SEARCH_BUDGET_H__
+
+#include <stddef.h>
+
+namespace crest {
+
+// Limits on the resources a search may use, other than its number of
+// iterations (see Search):
+//  - the total wall-clock time,
+//  - the total time spent in the solver,
+//  - the time for any one solver query, and
+//  - the time for any one execution of the program under test.
+// A limit of zero (the default) means no limit.
+//
+// Once the wall-clock, solver-time, or iteration budget has been used up
+// the budget is "exhausted", and the search unwinds.  (The per-query and
+// per-execution timeouts only cut short the query or execution at hand.)
+class SearchBudget {
+ public:
+  SearchBudget();
+
+  void set_max_time(double secs) { max_time_ = secs; }
+  void set_max_solver_time(double secs) { max_solver_time_ = secs; }
+  void set_query_timeout(double secs) { query_timeout_ = secs; }
+  void set_exec_timeout(double secs) { exec_timeout_ = secs; }
+
+  double query_timeout() const { return query_timeout_; }
+
+  // The timeout for the next execution -- the per-execution timeout, cut
+  // down to the wall-clock time remaining (or zero if neither is set).
+  double ExecTimeout() const;
+
+  // Starts the wall clock, with 'elapsed' seconds (e.g. of an earlier,
+  // checkpointed search) already used.
+  void Start(double elapsed);
+
+  double elapsed() const { return Now() - start_; }
+
+  double solver_time() const { return solver_time_; }
+  void set_solver_time(double secs) { solver_time_ = secs; }
+  void AddSolverTime(double secs) { solver_time_ += secs; }
+
+  // Returns true if the budget is exhausted -- i.e. Exhaust() has been
+  // called, or the wall-clock or solver-time limit has been reached.
+  bool Exhausted() {
+    return (reason_ != NULL) || CheckLimits();
+  }
+
+  // Marks the budget as exhausted, because of 'reason' (if it was not
+  // already exhausted).
+  void Exhaust(const char* reason) {
+    if (!reason_)
+      reason_ = reason;
+  }
+
+  // Why the budget was exhausted, or NULL if it is not.
+  const char* reason() const { return reason_; }
+
+  // The current time, in seconds.
+  static double Now();
+
+ private:
+  double max_time_;
+  double max_solver_time_;
+  double query_timeout_;
+  double exec_timeout_;
+
+  double start_;
+  double solver_time_;
+  const char* reason_;
+
+  bool CheckLimits();
+};
+
+}  // namespace crest
+
+#endif  // RUN_CREST_SEARCH_BUDGET_H__
@@ -0,0 +1,115 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <fstream>
+#include <vector>
+
+#include "base/event_buffer.h"
+#include "base/symbolic_execution.h"
+#include "base/symbolic_interpreter.h"
+
+using namespace crest;
+using namespace std;
+
+// Replays an event log (written by an instrumented program run with
+// CREST_EVENT_LOG set -- see base/event_buffer.h) through the symbolic
+// interpreter, without running the program, and reports how long the
+// interpretation took.  The rebuilt execution can be written out, in the
+// same format as "szd_execution".
+
+static double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static void PrintUsage() {
+  fprintf(stderr,
+          "Syntax: replay_events <event log> "
+          "[-o <execution file>] [-n <repetitions>]\n");
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+
+  const char* out_fname = NULL;
+  int reps = 1;
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "-o") && (i + 1 < argc)) {
+      out_fname = argv[++i];
+    } else if (!strcmp(argv[i], "-n") && (i + 1 < argc)) {
+      reps = atoi(argv[++i]);
+      if (reps < 1) {
+        fprintf(stderr, "Bad number of repetitions: %s\n", argv[i]);
+        PrintUsage();
+        return 1;
+      }
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  vector<Event> events;
+  if (!ReadEventLog(argv[1], &events)) {
+    fprintf(stderr, "Failed to read event log %s.\n", argv[1]);
+    return 1;
+  }
+
+  // The interpreter takes the inputs up front.
+  vector<value_t> input;
+  for (size_t i = 0; i < events.size(); i++) {
+    if (events[i].kind == events::NEW_INPUT)
+      input.push_back(events[i].value);
+  }
+
+  const Event* begin = events.empty() ? NULL : &events.front();
+  const Event* end = begin + events.size();
+  double total = 0;
+  SymbolicInterpreter* si = NULL;
+  for (int i = 0; i < reps; i++) {
+    delete si;
+    si = new SymbolicInterpreter(input);
+    double start = Now();
+    ReplayEvents(begin, end, si);
+    total += Now() - start;
+  }
+
+  const SymbolicExecution& ex = si->execution();
+  fprintf(stderr, "Replayed %zu events (%zu inputs) %d times.\n",
+          events.size(), input.size(), reps);
+  fprintf(stderr, "Execution: %zu branches, %zu constraints.\n",
+          ex.path().branches().size(), ex.path().constraints().size());
+  fprintf(stderr, "Time: %.3fs per replay, %.1f ns per event.\n",
+          total / reps,
+          events.empty() ? 0.0 : 1e9 * total / reps / events.size());
+
+  if (out_fname) {
+    string buff;
+    ex.Serialize(&buff);
+    ofstream out(out_fname, ios::out | ios::binary);
+    out.write(buff.data(), buff.size());
+    if (out.fail()) {
+      fprintf(stderr, "Failed to write %s.\n", out_fname);
+      return 1;
+    }
+  }
+
+  delete si;
+  return 0;
+}
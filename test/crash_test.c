@@ -0,0 +1,37 @@
+/* Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+ *
+ * This file is part of CREST, which is distributed under the revised
+ * BSD license.  A copy of this license can be found in the file LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+ * for details.
+ */
+
+
+#include <crest.h>
+#include <stdlib.h>
+
+/*
+ * Crashes after taking more branches than libcrest buffers, so each run
+ * leaves a trace without its end record.  Used by the check_truncated
+ * target.
+ */
+int main(void) {
+  int a, i, n = 0;
+  CREST_int(a);
+
+  if (a > 100) {
+    n++;
+  }
+
+  for (i = 0; i < 5000; i++) {
+    if (i % 2) {
+      n++;
+    }
+  }
+
+  abort();
+  return n;
+}
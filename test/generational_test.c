@@ -0,0 +1,46 @@
+/* Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+ *
+ * This file is part of CREST, which is distributed under the revised
+ * BSD license.  A copy of this license can be found in the file LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+ * for details.
+ */
+
+#include <crest.h>
+#include <stdio.h>
+
+/*
+ * Independent and nested branches, so that both depth-first and
+ * generational search can cover every branch in a few iterations.
+ * Used by the check_generational target.
+ */
+int main(void) {
+  int a, b, c, d;
+  CREST_int(a);
+  CREST_int(b);
+  CREST_int(c);
+  CREST_int(d);
+
+  if (a > 10) {
+    if (b == a + 3) {
+      fprintf(stderr, "a > 10 && b == a + 3\n");
+    }
+  } else if (a < -10) {
+    fprintf(stderr, "a < -10\n");
+  }
+
+  if (c == 2 * b) {
+    if (d < c) {
+      fprintf(stderr, "c == 2b && d < c\n");
+    }
+  }
+
+  if (a + b + c + d == 100) {
+    fprintf(stderr, "sum == 100\n");
+  }
+
+  return 0;
+}
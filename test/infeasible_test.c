@@ -0,0 +1,45 @@
+/* Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+ *
+ * This file is part of CREST, which is distributed under the revised
+ * BSD license.  A copy of this license can be found in the file LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+ * for details.
+ */
+
+#include <crest.h>
+#include <stdio.h>
+
+/*
+ * Takes the same branch on every run, but with a coefficient which
+ * depends on how many times the program has run (counted in the file
+ * "infeasible_test.count"): the true branch is infeasible on the first
+ * run and feasible on later ones.  Used by the check_infeasible target.
+ */
+int main(void) {
+  int a, c, runs = 0;
+  FILE* f;
+
+  f = fopen("infeasible_test.count", "r");
+  if (f) {
+    if (fscanf(f, "%d", &runs) != 1)
+      runs = 0;
+    fclose(f);
+  }
+  f = fopen("infeasible_test.count", "w");
+  if (f) {
+    fprintf(f, "%d\n", runs + 1);
+    fclose(f);
+  }
+  c = (runs == 0) ? 4 : 3;
+
+  CREST_int(a);
+  if (c * a == 6) {
+    printf("6\n");
+  } else {
+    printf("not 6\n");
+  }
+  return 0;
+}
@@ -0,0 +1,22 @@
+/* Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+ *
+ * This file is part of CREST, which is distributed under the revised
+ * BSD license.  A copy of this license can be found in the file LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+ * for details.
+ */
+
+#include <stdio.h>
+
+/* Called from multi_file_main.c. */
+int classify(int x) {
+  if (x < 10) {
+    return 0;
+  } else if (x < 100) {
+    return 1;
+  }
+  return 2;
+}
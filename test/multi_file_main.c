@@ -0,0 +1,36 @@
+/* Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+ *
+ * This file is part of CREST, which is distributed under the revised
+ * BSD license.  A copy of this license can be found in the file LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+ * for details.
+ */
+
+#include <crest.h>
+#include <stdio.h>
+
+/* Defined in multi_file_lib.c. */
+int classify(int x);
+
+int main(void) {
+  int a, b;
+  CREST_int(a);
+  CREST_int(b);
+
+  if (a > b) {
+    printf("a > b\n");
+    if (classify(a - b) == 2) {
+      printf("far apart\n");
+    }
+  } else {
+    printf("a <= b\n");
+    if (classify(b) == 0) {
+      printf("b is small\n");
+    }
+  }
+
+  return 0;
+}